@@ -0,0 +1,144 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "matrixKernelBench.cpp"
+//! \brief Microbenchmark of the matrix decomposition kernel.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+//! Builds without Maya or Ogre, for example:
+//!   g++ -O2 -I include bench/matrixKernelBench.cpp src/matrixKernel.cpp -o matrixKernelBench
+//! or enable the BUILD_BENCHMARKS CMake option.
+//!
+
+#include "matrixKernel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+
+using namespace OgreMayaExporter;
+
+// random number in [-1,1]
+static double random11()
+{
+	return rand() / (double)RAND_MAX * 2 - 1;
+}
+
+// build a matrix S * Sh * R * T from known components, in MMatrix layout
+static void buildMatrix(double m[4][4],double q[4],double s[3],double sh[3])
+{
+	double x=q[0], y=q[1], z=q[2], w=q[3];
+	// rotation rows for row vectors
+	double r[3][3] = {
+		{1-2*(y*y+z*z),	2*(x*y+z*w),	2*(x*z-y*w)},
+		{2*(x*y-z*w),	1-2*(x*x+z*z),	2*(y*z+x*w)},
+		{2*(x*z+y*w),	2*(y*z-x*w),	1-2*(x*x+y*y)}};
+	double shear[3][3] = {{1,0,0},{sh[0],1,0},{sh[1],sh[2],1}};
+	for (int i=0; i<3; i++)
+	{
+		for (int j=0; j<3; j++)
+		{
+			double v = 0;
+			for (int k=0; k<3; k++)
+				v += shear[i][k] * r[k][j];
+			m[i][j] = s[i] * v;
+		}
+		m[i][3] = 0;
+	}
+	m[3][0] = random11(); m[3][1] = random11(); m[3][2] = random11(); m[3][3] = 1;
+}
+
+int main()
+{
+	// a frame of a 300 joints skeleton, decomposed as many times as a 2000 frames clip
+	const size_t numJoints = 300;
+	const int numFrames = 2000;
+	std::vector<double> matrices(numJoints*16);
+	double (*m)[4][4] = (double (*)[4][4])&matrices[0];
+	std::vector<double> expected(numJoints*10);
+	for (size_t i=0; i<numJoints; i++)
+	{
+		double q[4] = {random11(),random11(),random11(),random11()};
+		double len = sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+		double sign = q[3] < 0 ? -1 : 1;
+		for (int k=0; k<4; k++)
+			q[k] *= sign / len;
+		double s[3] = {0.5 + rand()%100 / 50.0, 0.5 + rand()%100 / 50.0, 0.5 + rand()%100 / 50.0};
+		double sh[3] = {0,0,0};
+		if (i % 4 == 0)
+		{
+			sh[0] = random11() * 0.3; sh[1] = random11() * 0.3; sh[2] = random11() * 0.3;
+		}
+		buildMatrix(m[i],q,s,sh);
+		double e[10] = {q[0],q[1],q[2],q[3],s[0],s[1],s[2],sh[0],sh[1],sh[2]};
+		for (int k=0; k<10; k++)
+			expected[i*10+k] = e[k];
+	}
+
+	// check the results against the known components
+	decomposedMatrices d;
+	decomposeMatrices(m,numJoints,d);
+	double maxError = 0;
+	for (size_t i=0; i<numJoints; i++)
+	{
+		double b[10] = {d.qx[i],d.qy[i],d.qz[i],d.qw[i],d.sx[i],d.sy[i],d.sz[i],d.shxy[i],d.shxz[i],d.shyz[i]};
+		for (int k=0; k<10; k++)
+			maxError = fmax(maxError,fabs(b[k] - expected[i*10+k]));
+	}
+	printf("max error: %g\n",maxError);
+
+	// time the kernel
+	typedef std::chrono::high_resolution_clock clock;
+	clock::time_point start = clock::now();
+	for (int f=0; f<numFrames; f++)
+		decomposeMatrices(m,numJoints,d);
+	double time = std::chrono::duration<double,std::milli>(clock::now() - start).count();
+	printf("%d frames x %d joints: %.2f ms, %.1f ns per matrix\n",numFrames,(int)numJoints,time,time * 1e6 / (numFrames * numJoints));
+
+	return maxError < 1e-9 ? 0 : 1;
+}
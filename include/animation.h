@@ -87,14 +87,41 @@ namespace OgreMayaExporter
 		std::vector<vertexPoseRef> poserefs;
 	} vertexKeyframe;
 
-	// Skeleton animation keyframe
-	typedef struct skeletonKeyframeTag
+	// Skeleton animation keyframes of a track, stored as structure of arrays
+	typedef struct skeletonKeyframesTag
 	{
-		float time;								//time of keyframe
-		double tx,ty,tz;						//translation
-		double angle,axis_x,axis_y,axis_z;		//rotation
-		float sx,sy,sz;							//scale
-	} skeletonKeyframe;
+		std::vector<float> time;				//time of keyframes
+		std::vector<float> tx,ty,tz;			//translation
+		std::vector<float> qx,qy,qz,qw;			//rotation quaternion
+		std::vector<float> sx,sy,sz;			//scale
+		//get number of keyframes
+		size_t size() const {
+			return time.size();
+		}
+		//resize all arrays
+		void resize(size_t count) {
+			time.resize(count);
+			tx.resize(count); ty.resize(count); tz.resize(count);
+			qx.resize(count); qy.resize(count); qz.resize(count); qw.resize(count);
+			sx.resize(count); sy.resize(count); sz.resize(count);
+		}
+		//remove all keyframes
+		void clear() {
+			resize(0);
+		}
+		//keep only the keyframes at the given increasing indices
+		void keep(const std::vector<int>& indices) {
+			for (int i=0; i<indices.size(); i++)
+			{
+				int k = indices[i];
+				time[i] = time[k];
+				tx[i] = tx[k]; ty[i] = ty[k]; tz[i] = tz[k];
+				qx[i] = qx[k]; qy[i] = qy[k]; qz[i] = qz[k]; qw[i] = qw[k];
+				sx[i] = sx[k]; sy[i] = sy[k]; sz[i] = sz[k];
+			}
+			resize(indices.size());
+		}
+	} skeletonKeyframes;
 
 	// Blend shape data
 	typedef struct vertexOffestTag
@@ -138,10 +165,6 @@ namespace OgreMayaExporter
 		void addVertexKeyframe(vertexKeyframe& k) {
 			m_vertexKeyframes.push_back(k);
 		}
-		//add skeleton animation keyframe
-		void addSkeletonKeyframe(skeletonKeyframe& k) {
-			m_skeletonKeyframes.push_back(k);
-		}
 
 		//public members
 		trackType m_type;
@@ -149,7 +172,7 @@ namespace OgreMayaExporter
 		int m_index;
 		MString m_bone;
 		std::vector<vertexKeyframe> m_vertexKeyframes;
-		std::vector<skeletonKeyframe> m_skeletonKeyframes;
+		skeletonKeyframes m_skeletonKeyframes;
 	};
 	
 
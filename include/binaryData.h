@@ -0,0 +1,100 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "binaryData.h"
+//! \brief Little endian writers and hashing for the binary files of Ogre Exporter.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+
+#ifndef _BINARYDATA_H
+#define _BINARYDATA_H
+
+#include <vector>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace OgreMayaExporter
+{
+	// append little endian values to a byte buffer
+	inline void putU16(std::vector<unsigned char>& data,uint16_t v)
+	{
+		data.push_back(v & 0xff);
+		data.push_back((v >> 8) & 0xff);
+	}
+
+	inline void putU32(std::vector<unsigned char>& data,uint32_t v)
+	{
+		for (int i=0; i<4; i++)
+			data.push_back((v >> (8*i)) & 0xff);
+	}
+
+	inline void putFloat(std::vector<unsigned char>& data,float v)
+	{
+		uint32_t bits;
+		memcpy(&bits,&v,4);
+		putU32(data,bits);
+	}
+
+	// initial value of a 64 bit FNV-1a hash
+	const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+	// hash a value with 64 bit FNV-1a
+	inline void hashBytes(uint64_t& hash,const void* data,size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i=0; i<size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+}; // end of namespace
+
+#endif
@@ -94,8 +94,12 @@ namespace OgreMayaExporter
 		// Load blend shape poses for a submesh
 		MStatus loadPosesSubmesh(MDagPath& meshDag,ParamList &params,std::vector<vertex> &vertices,
 			std::vector<long>& indices,long targetIndex=0);
-		//load a blend shape animation track
-		Track loadTrack(float start,float stop,float rate,ParamList& params,int targetIndex,int startPoseId);
+		//load a blend shape animation keyframe at current time
+		vertexKeyframe loadKeyframe(float time,ParamList& params,int targetIndex,int startPoseId);
+		//remove references to poses that are never animated in a track
+		void optimiseTrack(Track& t);
+		// Count the pose offsets of the exported vertices in [first,first+count), from the stored target deltas
+		size_t countPoseOffsets(MDagPath& meshDag,const std::vector<vertex>& vertices,long first,long count);
 		// Get blend shape deformer name
 		MString getName();
 		// Get blend shape poses
@@ -119,8 +123,11 @@ namespace OgreMayaExporter
 		//load a blend shape pose for a submesh
 		MStatus loadPoseSubmesh(MDagPath& meshDag,ParamList& params,std::vector<vertex>& vertices,
 			std::vector<long>& indices,MString poseName,int targetIndex, int blendShapeIndex);
-		//load a blend shape animation keyframe
-		vertexKeyframe loadKeyframe(float time,ParamList& params,int targetIndex,int startPoseId);
+		//get the deltas of a target as stored on the deformer, fails for live shape targets
+		MStatus getTargetDeltas(MDagPath& meshDag,int weightIndex,MIntArray& vertexIndices,MPointArray& deltas);
+		//load a blend shape pose from the target deltas stored on the deformer
+		MStatus loadPoseDirect(MDagPath& meshDag,ParamList& params,std::vector<vertex>& vertices,
+			std::vector<std::vector<long> >& vertexMap,MString poseName,int targetIndex,int blendShapeIndex,int weightIndex);
 
 		// Protected members
 		//original values to restore after export
@@ -132,8 +139,6 @@ namespace OgreMayaExporter
 		target m_target;
 		//blend shape weights connections
 		std::vector<weightConnections> m_weightConnections;
-		// Array to determine if poses need to be optimized
-		MIntArray poseOptArray;	
 	};
 
 
@@ -121,6 +121,12 @@ namespace OgreMayaExporter
 	public:
 		//load texture data
 		MStatus loadTexture(MFnDependencyNode* pTexNode,TexOpType& opType,MStringArray& uvsets,ParamList& params);
+		//read texture data from a texture node
+		MStatus readTexture(MFnDependencyNode* pTexNode,TexOpType& opType,MStringArray& uvsets,ParamList& params,Texture& tex);
+		//look for a normal or bump map connected to the shader
+		MStatus loadNormalMap(MFnDependencyNode* pShader,MStringArray& uvsets,ParamList& params);
+		//check if the material samples a normal map in tangent space
+		bool needsTangents();
 
 		MString m_name;
 		MaterialType m_type;
@@ -130,6 +136,8 @@ namespace OgreMayaExporter
 		bool m_isTextured;
 		bool m_isMultiTextured;
 		std::vector<Texture> m_textures;
+		bool m_hasNormalMap;
+		Texture m_normalMap;
 	};
 
 };	//end of namespace
@@ -0,0 +1,81 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "matrixKernel.h"
+//! \brief Batched decomposition of transformation matrices for Ogre Exporter.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+
+#ifndef _MATRIXKERNEL_H
+#define _MATRIXKERNEL_H
+
+#include <vector>
+#include <stddef.h>
+
+namespace OgreMayaExporter
+{
+	/***** structure of arrays holding decomposed transformations *****/
+	typedef struct decomposedMatricesTag
+	{
+		std::vector<double> tx,ty,tz;			//translation
+		std::vector<double> qx,qy,qz,qw;		//rotation quaternion, qw >= 0
+		std::vector<double> sx,sy,sz;			//scale
+		std::vector<double> shxy,shxz,shyz;		//shear
+		//resize all arrays
+		void resize(size_t count);
+	} decomposedMatrices;
+
+	// Decompose an array of 4x4 row-major matrices (row vector convention, as MMatrix)
+	// into translation, rotation, scale and shear, matching the kPostTransform
+	// decomposition of MTransformationMatrix. A matrix with a negative determinant gets a
+	// negative scale on all axes. The function is pure math and safe to call from worker threads.
+	void decomposeMatrices(const double (*matrices)[4][4],size_t count,decomposedMatrices& out);
+
+}; // end of namespace
+
+#endif
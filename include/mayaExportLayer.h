@@ -85,6 +85,9 @@
 #include <maya/MFnIntArrayData.h>
 #include <maya/MFnDoubleArrayData.h>
 #include <maya/MFnVectorArrayData.h>
+#include <maya/MFnPointArrayData.h>
+#include <maya/MFnComponentListData.h>
+#include <maya/MFnSingleIndexedComponent.h>
 #include <maya/MArgList.h>
 #include <maya/MStatus.h>
 #include <maya/MDagPath.h>
@@ -115,6 +118,7 @@
 #include <maya/MQuaternion.h>
 #include <maya/MFnBlendShapeDeformer.h>
 #include <maya/MBoundingBox.h>
+#include <maya/MFnMatrixData.h>
 #include <maya/MDagModifier.h>
 
 // OGRE API
@@ -60,6 +60,8 @@
 #include "skeleton.h"
 #include "mayaExportLayer.h"
 #include "vertex.h"
+#include "workerPool.h"
+#include "timelineSampler.h"
 
 namespace OgreMayaExporter
 {
@@ -78,13 +80,40 @@ namespace OgreMayaExporter
 		std::vector<dagInfo> dagMap;
 	} sharedGeometry;
 
+	/***** structure to compare the cost of geometry layouts *****/
+	// estimated sizes used to choose between shared geometry and per-submesh vertex buffers,
+	// a vertex buffer bind costs ParamList::bindCost bytes
+	#define POSE_VERTEX_SIZE 16			// vertex index and position offset of a pose
+	#define MORPH_VERTEX_SIZE 12		// vertex position of a morph keyframe
+	#define BONE_ASSIGNMENT_SIZE 10		// vertex index, bone index and weight
+
+	typedef struct geometryLayoutCosttag
+	{
+		size_t vertexBytes;
+		size_t boneAssignmentBytes;
+		size_t indexBytes;
+		size_t poseBytes;
+		size_t morphBytes;
+		size_t binds;
+		size_t total;
+	} geometryLayoutCost;
+
+	/***** structure for a blend shape read by the blend shape clips *****/
+	typedef struct blendShapeSourcetag
+	{
+		BlendShape* pBlendShape;
+		target targetType;
+		int targetIndex;
+		int startPoseId;
+	} blendShapeSource;
+
 	typedef std::unordered_map<int,int> submeshPoseRemapping;
 
 	typedef std::unordered_map<int,submeshPoseRemapping> poseRemapping;
 
 
 	/***** Class Mesh *****/
-	class Mesh
+	class Mesh : public SampleConsumer
 	{
 	public:
 		//constructor
@@ -97,20 +126,30 @@ namespace OgreMayaExporter
 		Skeleton* getSkeleton();
 		//load mesh data from a maya Fn
 		MStatus load(const MDagPath& meshDag,ParamList &params);
-		//load vertex animations
+		//load skeleton, vertex and blend shape animations
 		MStatus loadAnims(ParamList &params);
+		//read animation data for a clip at current time
+		MStatus sample(sampleChannel channel,int clip,int key,float clipTime,ParamList& params);
 		//load blend shape deformers
 		MStatus loadBlendShapes(ParamList &params);
-		//load blend shape animations
-		MStatus loadBlendShapeAnimations(ParamList& params);
+		//remove the skeleton joints that don't deform the mesh and remap the bone assignments
+		MStatus pruneBones(ParamList& params);
+		//get the total skin weight of every skeleton joint
+		void getJointWeights(std::vector<float>& weights);
+		//order the skeleton joints breadth-first and remap the bone assignments
+		MStatus reorderBones(ParamList& params);
+		//choose between shared geometry and per-submesh vertex buffers (with "-shared auto")
+		MStatus chooseGeometryLayout(ParamList& params);
 		//write to a OGRE binary mesh
 		MStatus writeOgreBinary(ParamList &params);
+		//write the bounding volumes of the vertices influenced by each bone
+		MStatus writeBoneBounds(ParamList &params);
 
 		MString getName() {return m_name;}
 
 	protected:
 		//get uvsets info from the maya mesh
-		MStatus getUVSets(const MDagPath& meshDag);
+		MStatus getUVSets(const MDagPath& meshDag,ParamList& params);
 		//get skin cluster linked to the maya mesh
 		MStatus getSkinCluster(const MDagPath& meshDag,ParamList& params); 
 		//get blend shape deformer linked to the maya mesh
@@ -123,24 +162,44 @@ namespace OgreMayaExporter
 		MStatus getVertexBoneWeights(const MDagPath& meshDag,OgreMayaExporter::ParamList &params);
 		//get faces data
 		MStatus getFaces(const MDagPath& meshDag,ParamList& params);
+		//get faces data when only positions and bone weights are exported
+		MStatus getTriangles(const MDagPath& meshDag,ParamList& params);
 		//build shared geometry
 		MStatus buildSharedGeometry(const MDagPath& meshDag,ParamList& params);
 		//create submeshes
 		MStatus createSubmeshes(const MDagPath& meshDag,ParamList& params);
-		//load a vertex animation clip
-		MStatus loadClip(MString& clipName,float start,float stop,float rate,ParamList& params);
-		//load a vertex animation track for the whole mesh
-		MStatus loadMeshTrack(Animation& a,std::vector<float>& times,ParamList& params);
-		//load all submesh animation tracks (one for each submesh)
-		MStatus loadSubmeshTracks(Animation& a,std::vector<float>& times,ParamList& params);
+		//register vertex animation clips with the timeline sampler
+		MStatus registerVertexAnims(TimelineSampler& sampler,ParamList& params);
+		//find the animation curves driving the mesh shapes and their transforms
+		void findAnimCurves(MObjectArray& curves);
+		//register blend shape animation clips with the timeline sampler
+		MStatus registerBlendShapeAnims(TimelineSampler& sampler,ParamList& params);
+		//build the blend shape animations from the sampled weights
+		MStatus finaliseBlendShapeAnims(ParamList& params);
 		//load a keyframe for the whole mesh
 		MStatus loadKeyframe(Track& t,float time,ParamList& params);
+		//analyse which vertex attributes are used by the materials and drop the others
+		MStatus analyseAttributeUsage(ParamList& params);
+		//keep only the used texture coordinate sets of a vertex list
+		void compactTexCoords(std::vector<vertex>& vertices,const std::vector<bool>& usedSets);
+		//check if all vertices in a list have a white opaque colour
+		bool hasConstantWhiteColour(const std::vector<vertex>& vertices);
+		//build tangents for a single submesh with its own vertex data
+		MStatus buildOgreSubmeshTangents(Ogre::MeshPtr pMesh,int index,ParamList& params);
+		//get the estimated size of a vertex in an Ogre vertex buffer
+		size_t getVertexSize(const std::vector<vertex>& vertices,ParamList& params);
+		//get the estimated size of the bone assignments of a vertex list
+		size_t getBoneAssignmentsSize(const std::vector<vertex>& vertices,ParamList& params);
+		//print the estimated cost of a geometry layout
+		void printGeometryLayoutCost(const char* name,const geometryLayoutCost& cost);
 		//write shared geometry data to an Ogre compatible mesh
 		MStatus createOgreSharedGeometry(Ogre::MeshPtr pMesh,ParamList& params);
 		//create an Ogre compatible vertex buffer
 		MStatus createOgreVertexBuffer(Ogre::MeshPtr pMesh,Ogre::VertexDeclaration* pDecl,const std::vector<vertex>& vertices);
 		//create Ogre poses for pose animation
 		MStatus createOgrePoses(Ogre::MeshPtr pMesh,ParamList& params);
+		//write the poses of the Ogre mesh to a compact file
+		MStatus writePoseFile(Ogre::MeshPtr pMesh,ParamList& params);
 		//create vertex animations for an Ogre mesh
 		MStatus createOgreVertexAnimations(Ogre::MeshPtr pMesh,ParamList& params);
 		//create pose animations for an Ogre mesh
@@ -155,6 +214,9 @@ namespace OgreMayaExporter
 		sharedGeometry m_sharedGeom;
 		std::vector<Animation> m_vertexClips;
 		std::vector<Animation> m_BSClips;
+		std::vector<blendShapeSource> m_BSSources;
+		std::vector<Animation> m_BSSampledClips;
+		bool m_exportSharedColours;
 		//temporary members (existing only during translation from maya mesh)
 		std::vector<vertexInfo> newvertices;
 		std::vector<MFloatArray> newweights;
@@ -81,6 +81,14 @@ namespace OgreMayaExporter
 		bool offsetAnimation;					//clip will be created as offset to the first frame of animation
 	} clipInfo;
 
+	typedef struct animLodInfoTag
+	{
+		float rate;								//keys per second of the LOD variant
+		bool byWeight;							//select the joints by skin weight instead of depth
+		int maxDepth;							//deepest joints kept, roots are at depth 0
+		float minWeight;						//smallest share of the skin weight deformed by a kept joint and its descendants
+	} animLodInfo;
+
 	typedef enum
 	{
 		NPT_CURFRAME,
@@ -93,6 +101,16 @@ namespace OgreMayaExporter
 		TS_TANGENT
 	} TangentSemantic;
 
+	// Vertex attributes read from Maya
+	typedef enum
+	{
+		VA_POSITION		= 0x01,
+		VA_NORMAL		= 0x02,
+		VA_COLOUR		= 0x04,
+		VA_TEXCOORD		= 0x08,
+		VA_BLENDWEIGHTS	= 0x10
+	} VertexAttribute;
+
 	/***** Class ParamList *****/
 	class ParamList
 	{
@@ -101,17 +119,29 @@ namespace OgreMayaExporter
 		bool exportMesh, exportMaterial, exportAnimCurves, exportAnimCurvesXML, animSkipZeroValues, exportCameras, exportAll, exportVBA,
 			exportVertNorm, exportVertCol, exportTexCoord, exportCamerasAnim, exportCamerasAnimXML,
 			exportSkeleton, exportSkelAnims, exportBSAnims, optimizePoseAnimation, exportVertAnims, exportBlendShapes, 
-			exportWorldCoords, useSharedGeom, lightingOff, copyTextures, exportParticles,
-			buildTangents, preventZeroTangent, buildEdges, skelBB, bsBB, vertBB, 
-			tangentsSplitMirrored, tangentsSplitRotated, tangentsUseParity;			
+			exportWorldCoords, useSharedGeom, autoSharedGeom, lightingOff, copyTextures, exportParticles,
+			buildTangents, preventZeroTangent, buildEdges, skelBB, bsBB, bsDirect, poseDedupe, exportPoseFile, poseQuant, vertBB, 
+			tangentsSplitMirrored, tangentsSplitRotated, tangentsUseParity, optimizeAttributes, reduceSkelKeys,
+			pruneBones, pruneKeepInfluences, bfsBoneOrder, exportQuantAnims, exportBoneTextures, boneTexHalf, boneTexDDS,
+			splitClips, exportBoneBounds;			
 
 		Ogre::MeshVersion targetMeshVersion;
 
 		float lum;		// Length Unit Multiplier
 		float uvScale;	// UV scale factor to prevent zero tangents
+		float bindCost;	// Cost of a vertex buffer bind when choosing the geometry layout, in bytes of exported data
+		float poseDedupeTolerance;	// Largest difference between the offsets of poses exported only once
+		float autoRateTolerance;	// Largest deviation of a curve from linear between auto rate samples
+		float skelKeyTolTranslation, skelKeyTolRotation, skelKeyTolScale;	// Skeleton keyframe reduction tolerances (export units, degrees, scale factor)
+		float boneTexRate;	// Frames per second of the baked bone matrix textures
+		float boneBoundsWeight;	// Smallest weight of the vertices included in the bone bounding volumes
+
+		unsigned int numThreads;	// Worker threads used for exporting, 0 means one per hardware thread
+
+		unsigned int vertexAttributes;	// Mask of VertexAttribute flags to read from Maya
 
 		MString meshFilename, skeletonFilename, materialFilename, animFilename, camerasFilename, matPrefix,
-			texOutputDir, particlesFilename;
+			texOutputDir, particlesFilename, skeletonLibraryDir, animCacheFile;
 		// xml files
 		MString animFilenameXML, camerasFilenameXML;
 
@@ -121,9 +151,13 @@ namespace OgreMayaExporter
 
 		MStringArray writtenMaterials;
 
+		MStringArray keepBones;		// Name patterns of the joints never removed by pruneBones
+		MStringArray clipGroupNames, clipGroupPatterns;	// Skeleton clips written to the same file by splitClips
+
 		std::vector<clipInfo> skelClipList;
 		std::vector<clipInfo> BSClipList;
 		std::vector<clipInfo> vertClipList;
+		std::vector<animLodInfo> animLods;
 
 		NeutralPoseType neutralPoseType;
 		TangentSemantic tangentSemantic;
@@ -154,10 +188,15 @@ namespace OgreMayaExporter
 			exportTexCoord = false;
 			exportCamerasAnim = false;
 			useSharedGeom = false;
+			autoSharedGeom = false;
 			lightingOff = false;
 			copyTextures = false;
 			skelBB = false;
 			bsBB = false;
+			bsDirect = false;
+			poseDedupe = false;
+			exportPoseFile = false;
+			poseQuant = false;
 			vertBB = false;
 			meshFilename = "";
 			skeletonFilename = "";
@@ -167,14 +206,41 @@ namespace OgreMayaExporter
 			particlesFilename = "";
 			matPrefix = "";
 			texOutputDir = "";
+			skeletonLibraryDir = "";
+			animCacheFile = "";
 			skelClipList.clear();
 			BSClipList.clear();
 			vertClipList.clear();
+			animLods.clear();
 			neutralPoseType = NPT_CURFRAME;
 			buildEdges = false;
 			buildTangents = false;
 			preventZeroTangent = false;
+			optimizeAttributes = false;
 			uvScale = 10;
+			bindCost = 4096;
+			poseDedupeTolerance = 0.00001f;
+			autoRateTolerance = 0.001f;
+			reduceSkelKeys = false;
+			exportQuantAnims = false;
+			exportBoneTextures = false;
+			boneTexHalf = false;
+			boneTexDDS = true;
+			boneTexRate = 30;
+			splitClips = false;
+			exportBoneBounds = false;
+			boneBoundsWeight = 0.1f;
+			clipGroupNames.clear();
+			clipGroupPatterns.clear();
+			pruneBones = false;
+			pruneKeepInfluences = false;
+			keepBones.clear();
+			bfsBoneOrder = false;
+			skelKeyTolTranslation = 0.001f;
+			skelKeyTolRotation = 0.05f;
+			skelKeyTolScale = 0.001f;
+			numThreads = 0;
+			vertexAttributes = VA_POSITION;
 			tangentsSplitMirrored = false;
 			tangentsSplitRotated = false;
 			tangentsUseParity = false;
@@ -213,10 +279,15 @@ namespace OgreMayaExporter
 			exportCamerasAnim = source.exportCamerasAnim;
 			exportParticles = source.exportParticles;
 			useSharedGeom = source.useSharedGeom;
+			autoSharedGeom = source.autoSharedGeom;
 			lightingOff = source.lightingOff;
 			copyTextures = source.copyTextures;
 			skelBB = source.skelBB;
 			bsBB = source.bsBB;
+			bsDirect = source.bsDirect;
+			poseDedupe = source.poseDedupe;
+			exportPoseFile = source.exportPoseFile;
+			poseQuant = source.poseQuant;
 			vertBB = source.vertBB;
 			meshFilename = source.meshFilename;
 			skeletonFilename = source.skeletonFilename;
@@ -226,10 +297,36 @@ namespace OgreMayaExporter
 			particlesFilename = source.particlesFilename;
 			matPrefix = source.matPrefix;
 			texOutputDir = source.texOutputDir;
+			skeletonLibraryDir = source.skeletonLibraryDir;
+			animCacheFile = source.animCacheFile;
 			buildEdges = source.buildEdges;
 			buildTangents = source.buildTangents;
 			preventZeroTangent = source.preventZeroTangent;
+			optimizeAttributes = source.optimizeAttributes;
 			uvScale = source.uvScale;
+			bindCost = source.bindCost;
+			poseDedupeTolerance = source.poseDedupeTolerance;
+			autoRateTolerance = source.autoRateTolerance;
+			reduceSkelKeys = source.reduceSkelKeys;
+			exportQuantAnims = source.exportQuantAnims;
+			exportBoneTextures = source.exportBoneTextures;
+			boneTexHalf = source.boneTexHalf;
+			boneTexDDS = source.boneTexDDS;
+			boneTexRate = source.boneTexRate;
+			splitClips = source.splitClips;
+			exportBoneBounds = source.exportBoneBounds;
+			boneBoundsWeight = source.boneBoundsWeight;
+			clipGroupNames = source.clipGroupNames;
+			clipGroupPatterns = source.clipGroupPatterns;
+			pruneBones = source.pruneBones;
+			pruneKeepInfluences = source.pruneKeepInfluences;
+			keepBones = source.keepBones;
+			bfsBoneOrder = source.bfsBoneOrder;
+			skelKeyTolTranslation = source.skelKeyTolTranslation;
+			skelKeyTolRotation = source.skelKeyTolRotation;
+			skelKeyTolScale = source.skelKeyTolScale;
+			numThreads = source.numThreads;
+			vertexAttributes = source.vertexAttributes;
 			tangentsSplitMirrored = source.tangentsSplitMirrored;
 			tangentsSplitRotated = source.tangentsSplitRotated;
 			tangentsUseParity = source.tangentsUseParity;
@@ -258,6 +355,7 @@ namespace OgreMayaExporter
 				vertClipList[i].stop = source.vertClipList[i].stop;
 				vertClipList[i].rate = source.vertClipList[i].rate;
 			}
+			animLods = source.animLods;
 			neutralPoseType = source.neutralPoseType;
 			for (i=0; i<source.loadedSubmeshes.size(); i++)
 				loadedSubmeshes.push_back(source.loadedSubmeshes[i]);
@@ -288,8 +386,10 @@ namespace OgreMayaExporter
 			if (outCamerasXML)
 				outCamerasXML.close();			
 		}
-		// method to pars arguments and set parameters
-		void parseArgs(const MArgList &args);
+		// method to pars arguments and set parameters, fails on invalid option values
+		MStatus parseArgs(const MArgList &args);
+		// method to build the mask of vertex attributes to read from Maya
+		unsigned int buildVertexAttributeMask();
 		// method to open files for writing
 		MStatus openFiles();
 		// method to close open output files
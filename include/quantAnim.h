@@ -0,0 +1,452 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "quantAnim.h"
+//! \brief Quantised skeletal animation format, with a header-only decoder.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+//! The decoder only depends on the standard library, so this header can be
+//! copied into a runtime as is.
+//!
+
+#ifndef _QUANTANIM_H
+#define _QUANTANIM_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define QUANTANIM_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace OgreMayaExporter
+{
+	// File layout, all values little endian:
+	//  header:		char[4] "QANM", uint32 version, uint32 number of bones, uint32 number of clips
+	//  clip:		uint16 name length, name, float length, uint32 number of tracks, tracks
+	//  track:		uint16 bone handle, uint16 constant channel flags, uint32 number of keys,
+	//				uint16 key times (0..65535 over the clip length), translation, rotation, scale
+	//  translation and scale:	constant -> float[3], else float min[3], float extent[3], uint16[3] per key
+	//  rotation:	constant -> one quaternion, else one quaternion per key, stored as uint16[3]
+	// Quaternions are stored as smallest three: the index of the largest component in 2 bits and
+	// the other three components in 15 bits each, the largest one is rebuilt as positive.
+	// Transforms are relative to the bind pose of the bones, as in Ogre skeleton animations.
+	const uint32_t QUANTANIM_VERSION = 1;
+	enum { QA_CONST_TRANSLATION = 1, QA_CONST_ROTATION = 2, QA_CONST_SCALE = 4 };
+
+	/***** quantised animation track *****/
+	typedef struct quantAnimTrackTag
+	{
+		uint16_t bone;
+		uint16_t flags;
+		uint32_t numKeys;
+		std::vector<uint16_t> times;
+		float tMin[3], tExtent[3];				//translation range, tMin holds a constant translation
+		std::vector<uint16_t> translations;		//3 per key, empty if constant
+		std::vector<uint16_t> rotations;		//3 per key, 3 if constant
+		float sMin[3], sExtent[3];				//scale range, sMin holds a constant scale
+		std::vector<uint16_t> scales;			//3 per key, empty if constant
+	} quantAnimTrack;
+
+	/***** quantised animation clip *****/
+	typedef struct quantAnimClipTag
+	{
+		std::string name;
+		float length;
+		std::vector<quantAnimTrack> tracks;
+	} quantAnimClip;
+
+	/***** sampled pose, structure of arrays indexed by bone handle *****/
+	typedef struct quantAnimPoseTag
+	{
+		std::vector<float> tx,ty,tz;
+		std::vector<float> qx,qy,qz,qw;
+		std::vector<float> sx,sy,sz;
+		// scratch buffers of the keys being interpolated
+		std::vector<float> a[10],b[10],alpha;
+		//resize the pose and set it to identity
+		void reset(size_t numBones) {
+			tx.assign(numBones,0); ty.assign(numBones,0); tz.assign(numBones,0);
+			qx.assign(numBones,0); qy.assign(numBones,0); qz.assign(numBones,0); qw.assign(numBones,1);
+			sx.assign(numBones,1); sy.assign(numBones,1); sz.assign(numBones,1);
+		}
+	} quantAnimPose;
+
+	// pack a normalised quaternion (x,y,z,w) as smallest three
+	inline void packQuaternion(const float q[4],uint16_t out[3])
+	{
+		int largest = 0;
+		for (int i=1; i<4; i++)
+		{
+			if (fabs(q[i]) > fabs(q[largest]))
+				largest = i;
+		}
+		// q and -q are the same rotation, flip it so the dropped component is positive
+		float sign = q[largest] < 0 ? -1.0f : 1.0f;
+		uint64_t packed = (uint64_t)largest << 45;
+		for (int i=0,c=0; i<4; i++)
+		{
+			if (i == largest)
+				continue;
+			// the other components are in [-1/sqrt(2),1/sqrt(2)]
+			float v = q[i] * sign * 0.70710678f * 2.0f;
+			int iv = (int)floor((v * 0.5f + 0.5f) * 32767.0f + 0.5f);
+			iv = std::max(0,std::min(32767,iv));
+			packed |= (uint64_t)iv << (15*c);
+			c++;
+		}
+		out[0] = (uint16_t)(packed & 0xffff);
+		out[1] = (uint16_t)((packed >> 16) & 0xffff);
+		out[2] = (uint16_t)((packed >> 32) & 0xffff);
+	}
+
+	// unpack a smallest three quaternion
+	inline void unpackQuaternion(const uint16_t in[3],float q[4])
+	{
+		uint64_t packed = (uint64_t)in[0] | ((uint64_t)in[1] << 16) | ((uint64_t)in[2] << 32);
+		int largest = (int)((packed >> 45) & 3);
+		float sum = 0;
+		for (int i=0,c=0; i<4; i++)
+		{
+			if (i == largest)
+				continue;
+			float v = ((packed >> (15*c)) & 0x7fff) / 32767.0f * 2.0f - 1.0f;
+			q[i] = v * 0.70710678f;
+			sum += q[i] * q[i];
+			c++;
+		}
+		q[largest] = sqrt(std::max(0.0f,1.0f - sum));
+	}
+
+	// quantise a value to 16 bits in a range
+	inline uint16_t quantiseValue(float v,float min,float extent)
+	{
+		if (extent <= 0)
+			return 0;
+		int iv = (int)floor((v - min) / extent * 65535.0f + 0.5f);
+		return (uint16_t)std::max(0,std::min(65535,iv));
+	}
+
+	// rebuild a value quantised to 16 bits
+	inline float dequantiseValue(uint16_t v,float min,float extent)
+	{
+		return min + v / 65535.0f * extent;
+	}
+
+
+	/*********** Class QuantAnimDecoder **********************/
+	class QuantAnimDecoder
+	{
+	public:
+		//constructor
+		QuantAnimDecoder() {
+			m_numBones = 0;
+		}
+		//parse a quantised animation file loaded in memory, returns false if the data is not valid
+		bool load(const unsigned char* data,size_t size) {
+			m_clips.clear();
+			m_numBones = 0;
+			m_pData = data;
+			m_size = size;
+			m_pos = 0;
+			uint32_t version = 0, numClips = 0;
+			if (size < 4 || memcmp(data,"QANM",4) != 0)
+				return false;
+			m_pos = 4;
+			if (!readU32(version) || version != QUANTANIM_VERSION || !readU32(m_numBones) || !readU32(numClips))
+				return false;
+			// check the counts against the remaining data before allocating
+			if (numClips > (m_size - m_pos) / MIN_CLIP_SIZE)
+				return false;
+			m_clips.resize(numClips);
+			for (uint32_t i=0; i<numClips; i++)
+			{
+				quantAnimClip& clip = m_clips[i];
+				uint16_t nameLength = 0;
+				uint32_t numTracks = 0;
+				if (!readU16(nameLength) || m_pos + nameLength > m_size)
+					return false;
+				clip.name.assign((const char*)m_pData + m_pos,nameLength);
+				m_pos += nameLength;
+				if (!readFloat(clip.length) || !readU32(numTracks) || numTracks > (m_size - m_pos) / MIN_TRACK_SIZE)
+					return false;
+				clip.tracks.resize(numTracks);
+				for (uint32_t j=0; j<numTracks; j++)
+				{
+					if (!readTrack(clip.tracks[j]))
+						return false;
+				}
+			}
+			return true;
+		}
+		//get number of bones of the skeleton
+		uint32_t numBones() const {
+			return m_numBones;
+		}
+		//get loaded clips
+		const std::vector<quantAnimClip>& clips() const {
+			return m_clips;
+		}
+		//decode a key of a track
+		static void decodeKey(const quantAnimTrack& track,uint32_t key,float t[3],float q[4],float s[3]) {
+			for (int i=0; i<3; i++)
+			{
+				t[i] = (track.flags & QA_CONST_TRANSLATION) ? track.tMin[i] :
+					dequantiseValue(track.translations[3*key+i],track.tMin[i],track.tExtent[i]);
+				s[i] = (track.flags & QA_CONST_SCALE) ? track.sMin[i] :
+					dequantiseValue(track.scales[3*key+i],track.sMin[i],track.sExtent[i]);
+			}
+			unpackQuaternion(&track.rotations[(track.flags & QA_CONST_ROTATION) ? 0 : 3*key],q);
+		}
+		//find the keys around a time and the interpolation factor between them
+		static void findKeys(const quantAnimTrack& track,float length,float time,uint32_t& key0,uint32_t& key1,float& alpha) {
+			float qt = length > 0 ? time / length * 65535.0f : 0;
+			std::vector<uint16_t>::const_iterator it = std::upper_bound(track.times.begin(),track.times.end(),qt,
+				[](float v,uint16_t t) { return v < t; });
+			key1 = std::min((uint32_t)(it - track.times.begin()),track.numKeys - 1);
+			key0 = key1 > 0 ? key1 - 1 : 0;
+			if (it == track.times.end())
+				key0 = key1;
+			float span = (float)track.times[key1] - track.times[key0];
+			alpha = span > 0 ? std::max(0.0f,std::min(1.0f,(qt - track.times[key0]) / span)) : 0;
+		}
+		//sample a single track at a time of its clip
+		static void sampleTrack(const quantAnimTrack& track,float length,float time,float t[3],float q[4],float s[3]) {
+			uint32_t key0, key1;
+			float alpha;
+			findKeys(track,length,time,key0,key1,alpha);
+			float t1[3], q1[4], s1[3];
+			decodeKey(track,key0,t,q,s);
+			decodeKey(track,key1,t1,q1,s1);
+			float dot = q[0]*q1[0] + q[1]*q1[1] + q[2]*q1[2] + q[3]*q1[3];
+			float sign = dot < 0 ? -1.0f : 1.0f;
+			float len = 0;
+			for (int i=0; i<4; i++)
+			{
+				q[i] += (sign * q1[i] - q[i]) * alpha;
+				len += q[i] * q[i];
+			}
+			len = len > 0 ? 1.0f / sqrt(len) : 1.0f;
+			for (int i=0; i<4; i++)
+				q[i] *= len;
+			for (int i=0; i<3; i++)
+			{
+				t[i] += (t1[i] - t[i]) * alpha;
+				s[i] += (s1[i] - s[i]) * alpha;
+			}
+		}
+		//sample all tracks of a clip into a pose, bones without a track are left untouched.
+		//Keys are decoded per track, then interpolated four tracks at a time with SSE2 when available
+		void sampleClip(size_t clipIndex,float time,quantAnimPose& pose) const {
+			const quantAnimClip& clip = m_clips[clipIndex];
+			size_t numTracks = clip.tracks.size();
+			size_t padded = (numTracks + 3) & ~(size_t)3;
+			if (pose.tx.size() < m_numBones)
+				pose.reset(m_numBones);
+			for (int c=0; c<10; c++)
+			{
+				pose.a[c].resize(padded);
+				pose.b[c].resize(padded);
+			}
+			pose.alpha.assign(padded,0);
+			// decode the keys around the sampled time, channels are t(0-2), q(3-6), s(7-9)
+			for (size_t i=0; i<padded; i++)
+			{
+				float ka[10] = {0,0,0, 0,0,0,1, 1,1,1};
+				float kb[10] = {0,0,0, 0,0,0,1, 1,1,1};
+				if (i < numTracks)
+				{
+					uint32_t key0, key1;
+					findKeys(clip.tracks[i],clip.length,time,key0,key1,pose.alpha[i]);
+					decodeKey(clip.tracks[i],key0,ka,ka+3,ka+7);
+					decodeKey(clip.tracks[i],key1,kb,kb+3,kb+7);
+				}
+				for (int c=0; c<10; c++)
+				{
+					pose.a[c][i] = ka[c];
+					pose.b[c][i] = kb[c];
+				}
+			}
+			// interpolate, the result is written back to the first key
+			size_t i = 0;
+#ifdef QUANTANIM_SSE2
+			for (; i<padded; i+=4)
+			{
+				__m128 alpha = _mm_loadu_ps(&pose.alpha[i]);
+				__m128 a[10], b[10];
+				for (int c=0; c<10; c++)
+				{
+					a[c] = _mm_loadu_ps(&pose.a[c][i]);
+					b[c] = _mm_loadu_ps(&pose.b[c][i]);
+				}
+				// take the shortest path between the quaternions
+				__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[3],b[3]),_mm_mul_ps(a[4],b[4])),
+					_mm_add_ps(_mm_mul_ps(a[5],b[5]),_mm_mul_ps(a[6],b[6])));
+				__m128 signMask = _mm_and_ps(_mm_cmplt_ps(dot,_mm_setzero_ps()),_mm_set1_ps(-0.0f));
+				for (int c=3; c<7; c++)
+					b[c] = _mm_xor_ps(b[c],signMask);
+				for (int c=0; c<10; c++)
+					a[c] = _mm_add_ps(a[c],_mm_mul_ps(_mm_sub_ps(b[c],a[c]),alpha));
+				__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[3],a[3]),_mm_mul_ps(a[4],a[4])),
+					_mm_add_ps(_mm_mul_ps(a[5],a[5]),_mm_mul_ps(a[6],a[6]))));
+				for (int c=3; c<7; c++)
+					a[c] = _mm_div_ps(a[c],len);
+				for (int c=0; c<10; c++)
+					_mm_storeu_ps(&pose.a[c][i],a[c]);
+			}
+#endif
+			for (; i<numTracks; i++)
+			{
+				float alpha = pose.alpha[i];
+				float dot = pose.a[3][i]*pose.b[3][i] + pose.a[4][i]*pose.b[4][i] + pose.a[5][i]*pose.b[5][i] + pose.a[6][i]*pose.b[6][i];
+				float sign = dot < 0 ? -1.0f : 1.0f;
+				for (int c=3; c<7; c++)
+					pose.b[c][i] *= sign;
+				for (int c=0; c<10; c++)
+					pose.a[c][i] += (pose.b[c][i] - pose.a[c][i]) * alpha;
+				float len = sqrt(pose.a[3][i]*pose.a[3][i] + pose.a[4][i]*pose.a[4][i] + pose.a[5][i]*pose.a[5][i] + pose.a[6][i]*pose.a[6][i]);
+				for (int c=3; c<7; c++)
+					pose.a[c][i] /= len;
+			}
+			// scatter to the bones
+			for (size_t j=0; j<numTracks; j++)
+			{
+				uint16_t bone = clip.tracks[j].bone;
+				if (bone >= m_numBones)
+					continue;
+				pose.tx[bone] = pose.a[0][j]; pose.ty[bone] = pose.a[1][j]; pose.tz[bone] = pose.a[2][j];
+				pose.qx[bone] = pose.a[3][j]; pose.qy[bone] = pose.a[4][j]; pose.qz[bone] = pose.a[5][j]; pose.qw[bone] = pose.a[6][j];
+				pose.sx[bone] = pose.a[7][j]; pose.sy[bone] = pose.a[8][j]; pose.sz[bone] = pose.a[9][j];
+			}
+		}
+
+	protected:
+		//smallest encoded sizes: an empty clip name, length and track count, and a track of one key
+		//with constant translation, rotation and scale
+		enum { MIN_CLIP_SIZE = 2 + 4 + 4, MIN_TRACK_SIZE = 2 + 2 + 4 + 2 + 12 + 6 + 12 };
+		//read values, return false past the end of the data
+		bool readU16(uint16_t& v) {
+			if (m_pos + 2 > m_size)
+				return false;
+			v = (uint16_t)(m_pData[m_pos] | (m_pData[m_pos+1] << 8));
+			m_pos += 2;
+			return true;
+		}
+		bool readU32(uint32_t& v) {
+			if (m_pos + 4 > m_size)
+				return false;
+			v = (uint32_t)m_pData[m_pos] | ((uint32_t)m_pData[m_pos+1] << 8) |
+				((uint32_t)m_pData[m_pos+2] << 16) | ((uint32_t)m_pData[m_pos+3] << 24);
+			m_pos += 4;
+			return true;
+		}
+		bool readFloat(float& v) {
+			uint32_t bits;
+			if (!readU32(bits))
+				return false;
+			memcpy(&v,&bits,4);
+			return true;
+		}
+		bool readU16Array(std::vector<uint16_t>& v,size_t count) {
+			if (count > (m_size - m_pos) / 2)
+				return false;
+			v.resize(count);
+			for (size_t i=0; i<count; i++)
+			{
+				if (!readU16(v[i]))
+					return false;
+			}
+			return true;
+		}
+		bool readRange(float min[3],float extent[3],std::vector<uint16_t>& values,bool constant,uint32_t numKeys) {
+			for (int i=0; i<3; i++)
+			{
+				extent[i] = 0;
+				if (!readFloat(min[i]))
+					return false;
+			}
+			if (constant)
+			{
+				values.clear();
+				return true;
+			}
+			for (int i=0; i<3; i++)
+			{
+				if (!readFloat(extent[i]))
+					return false;
+			}
+			return readU16Array(values,3*(size_t)numKeys);
+		}
+		bool readTrack(quantAnimTrack& track) {
+			if (!readU16(track.bone) || !readU16(track.flags) || !readU32(track.numKeys) || track.numKeys == 0)
+				return false;
+			if (!readU16Array(track.times,track.numKeys))
+				return false;
+			if (!readRange(track.tMin,track.tExtent,track.translations,(track.flags & QA_CONST_TRANSLATION) != 0,track.numKeys))
+				return false;
+			if (!readU16Array(track.rotations,(track.flags & QA_CONST_ROTATION) ? 3 : 3*(size_t)track.numKeys))
+				return false;
+			return readRange(track.sMin,track.sExtent,track.scales,(track.flags & QA_CONST_SCALE) != 0,track.numKeys);
+		}
+
+		uint32_t m_numBones;
+		std::vector<quantAnimClip> m_clips;
+		const unsigned char* m_pData;
+		size_t m_size;
+		size_t m_pos;
+	};
+
+}; // end of namespace
+
+#endif
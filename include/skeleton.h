@@ -59,6 +59,10 @@
 #include "mayaExportLayer.h"
 #include "paramList.h"
 #include "animation.h"
+#include "timelineSampler.h"
+#include "workerPool.h"
+#include "matrixKernel.h"
+#include "quantAnim.h"
 
 namespace OgreMayaExporter
 {
@@ -68,6 +72,7 @@ namespace OgreMayaExporter
 		MString name;
 		int id;
 		MMatrix localMatrix;
+		MMatrix invLocalMatrix;
 		MMatrix bindMatrix;
 		int parentIndex;
 		double posx,posy,posz;
@@ -75,11 +80,29 @@ namespace OgreMayaExporter
 		double axisx,axisy,axisz;
 		float scalex,scaley,scalez;
 		MDagPath jointDag;
+		bool evalLocal;			//joint is a direct dag child of its parent joint
+		MPlug matrixPlug;		//local transformation matrix of the joint node
+		bool influence;			//joint is an influence object of a skin cluster
 	} joint;
 
 
+	/***** structure to hold the joint matrices captured at a sampled time *****/
+	typedef struct skeletonFrametag
+	{
+		int clip;
+		int key;
+		float clipTime;
+		std::vector<MMatrix> localMatrices;		//local matrix of joints evaluated from their parent
+		std::vector<MMatrix> worldMatrices;		//inclusive matrix of every joint
+		std::vector<MMatrix> rootMatrices;		//exclusive matrix inverse of root joints
+		std::vector<int> keyJoints;				//joints that get a keyframe at this sample
+		std::vector<MMatrix> relMatrices;		//transformation of the key joints relative to their bind pose
+		decomposedMatrices decomposed;			//decomposed relative matrices
+	} skeletonFrame;
+
+
 	/*********** Class Skeleton **********************/
-	class Skeleton
+	class Skeleton : public SampleConsumer
 	{
 	public:
 		//constructor
@@ -90,35 +113,94 @@ namespace OgreMayaExporter
 		void clear();
 		//load skeleton data
 		MStatus load(MFnSkinCluster* pSkinCluster,ParamList& params);
-		//load skeletal animations
-		MStatus loadAnims(ParamList& params);
+		//remove the joints that don't deform the mesh, weighted flags the joints with weighted vertices,
+		//remap receives the new index of every joint (-1 for removed ones)
+		MStatus pruneJoints(const std::vector<bool>& weighted,ParamList& params,std::vector<int>& remap);
+		//renumber the joints breadth-first, remap receives the new index of every joint
+		MStatus reorderJoints(ParamList& params,std::vector<int>& remap);
+		//find the animation curves driving the joints, with the driven key curves if drivenKeys is true
+		void findAnimCurves(MObjectArray& curves,bool drivenKeys = false);
+		//register skeletal animation clips with the timeline sampler
+		MStatus registerAnims(TimelineSampler& sampler,ParamList& params);
+		//prepare the frame pipeline
+		MStatus beginSampling(ParamList& params);
+		//capture the joint matrices for a clip at current time, keyframes are computed on a worker
+		MStatus sample(sampleChannel channel,int clip,int key,float clipTime,ParamList& params);
+		//wait for the pending keyframes and release the frame pipeline
+		MStatus endSampling(ParamList& params);
+		//create the LOD variants of the sampled clips, jointWeights holds the skin weight of every joint
+		void createLodAnims(const std::vector<float>& jointWeights,ParamList& params);
+		//reduce the sampled keyframes and print info about the loaded skeletal animations
+		void finaliseAnims(ParamList& params);
+		//drop keyframes that interpolation rebuilds within the reduction tolerances
+		void reduceKeyframes(ParamList& params);
 		//get joints
 		std::vector<joint>& getJoints();
+		//get the index of a joint from its partial path name, -1 if not loaded
+		int getJointIndex(const MString& name) const;
 		//get animations
 		std::vector<Animation>& getAnimations();
 		//restore skeleton pose
 		void restorePose();
+		//get the bind pose of the bones, relative to their parent or in model space (derived)
+		void getBindTransforms(std::vector<Ogre::Vector3>& position,std::vector<Ogre::Quaternion>& orientation,
+			std::vector<Ogre::Vector3>& scale,bool derived);
+		//get the hash of the hierarchy and bind pose of the skeleton
+		MString getBindPoseHash();
+		//get the path of the skeleton in the shared skeleton library
+		MString getLibraryFilename(ParamList &params);
 		//write to an OGRE binary skeleton
 		MStatus writeOgreBinary(ParamList &params);
+		//write the first joint and number of joints of each level of a breadth-first ordered skeleton
+		MStatus writeLevels(ParamList &params);
+		//write the skeleton animations to a quantised file and print the reconstruction error of every joint
+		MStatus writeQuantAnims(ParamList &params);
+		//bake the skinning matrices of every bone in every clip to a texture, with an index of the clip frames
+		MStatus writeBoneTextures(ParamList &params);
+		//write the skeleton animations to one skeleton file per clip or group of clips
+		MStatus writeClipSkeletons(ParamList &params);
 		// test for shear(non-uniform scale)
 		void Skeleton::testShear( MString&, MMatrix&, const std::string& );
 
 	protected:
 		//load a joint
 		MStatus loadJoint(MDagPath& jointDag, joint* parent, ParamList& params,MFnSkinCluster* pSkinCluster);
-		//load a clip
-		MStatus loadClip(MString clipName,float start,float stop,float rate,ParamList& params);
-		//load a keyframe for a particular joint at current time
-		skeletonKeyframe loadKeyframe(joint& j,float time,ParamList& params);
+		//set the local bind pose of a joint
+		void setBindPose(joint& j,const MMatrix& localMatrix,ParamList& params);
+		//get the fingerprint of the inputs of a clip
+		uint64_t getClipFingerprint(const clipInfo& ci,const MObjectArray& curves,ParamList& params);
+		//load the clips of the animation cache file
+		void loadAnimCache(ParamList& params);
+		//save the sampled clips to the animation cache file
+		void saveAnimCache(ParamList& params);
+		//find the joints whose local matrix may change during a clip
+		void findAnimatedJoints(const std::vector<float>& times,std::vector<bool>& animated);
+		//compute the keyframes of all joints from captured matrices (safe to run on a worker thread)
+		void processFrame(skeletonFrame& frame,ParamList& params);
+		//store a keyframe from a decomposed relative matrix (safe to run on a worker thread)
+		void loadKeyframe(const decomposedMatrices& d,int index,skeletonKeyframes& keys,int key,float time,ParamList& params);
 		//write joints to an Ogre skeleton
 		MStatus createOgreBones(Ogre::SkeletonPtr pSkeleton,ParamList& params);
 		// write skeleton animations to an Ogre skeleton
-		MStatus createOgreSkeletonAnimations(Ogre::SkeletonPtr pSkeleton,ParamList& params);
+		MStatus createOgreSkeletonAnimations(Ogre::SkeletonPtr pSkeleton,const std::vector<int>& clips,ParamList& params);
+		//get the bone handle of every track of a clip
+		void getTrackBones(int clip,std::vector<int>& trackBones);
 		
 		std::vector<joint> m_joints;
+		std::unordered_map<std::string,int> m_jointIndices;	//joint index by name
 		std::vector<Animation> m_animations;
 		std::vector<int> m_roots;
+		std::vector<int> m_levelStarts;		//first joint of each level, when ordered breadth-first
 		MString m_restorePose;
+		FramePipeline* m_pPipeline;
+		std::vector<skeletonFrame> m_frames;
+		std::vector<std::vector<bool> > m_animatedJoints;		//joints animated in each clip
+		std::vector<std::vector<MMatrix> > m_staticMatrices;	//local matrix of the static joints of each clip
+		std::mutex m_shearMutex;
+		std::set<int> m_shearedJoints;
+		std::vector<uint64_t> m_clipFingerprints;		//fingerprint of each sampled clip
+		std::vector<Animation> m_cachedAnims;			//clips loaded from the animation cache
+		std::vector<uint64_t> m_cachedFingerprints;		//fingerprint of each cached clip
 	};
 
 }	//end namespace
@@ -79,6 +79,8 @@ namespace OgreMayaExporter
 		MStatus loadMaterial(MObject& shader,MStringArray& uvsets,ParamList& params);
 		MStatus load(const MDagPath& dag,std::vector<face>& faces, std::vector<vertexInfo>& vertInfo, MPointArray& points,
 			MFloatVectorArray& normals, MStringArray& texcoordsets,ParamList& params,bool opposite = false); 
+		//load faces indexing the shared vertex buffer (when the geometry layout is chosen after loading)
+		void loadSharedFaces(std::vector<face>& faces,long vertexOffset,bool opposite = false);
 		//load a keyframe for the whole mesh
 		MStatus loadKeyframe(Track& t,float time,ParamList& params);
 		//get number of triangles composing the submesh
@@ -87,10 +89,16 @@ namespace OgreMayaExporter
 		long numVertices();
 		//get submesh name
 		MString& name();
-		//write submesh data to an Ogre compatible mesh
+		//create the Ogre submesh and allocate its buffers (not thread safe)
 		MStatus createOgreSubmesh(Ogre::MeshPtr pMesh,const ParamList& params);
-		//create an Ogre compatible vertex buffer
-		MStatus createOgreVertexBuffer(Ogre::SubMesh* pSubmesh,Ogre::VertexDeclaration* pDecl,const std::vector<vertex>& vertices);
+		//fill the Ogre submesh buffers and collect bone assignments (safe to run on a worker thread)
+		MStatus fillOgreSubmesh(const ParamList& params);
+		//add collected bone assignments to the Ogre submesh (not thread safe)
+		MStatus addOgreBoneAssignments(const ParamList& params);
+		//append the rationalised bone assignments of a vertex to a list
+		static void rationaliseBoneAssignments(const vertex& v,unsigned int vertexIndex,std::vector<Ogre::VertexBoneAssignment>& vbas);
+		//fill all vertex buffers bound to an Ogre vertex data
+		MStatus fillOgreVertexBuffers(Ogre::VertexData* pVertexData,const std::vector<vertex>& vertices);
 
 	public:
 		//public members
@@ -101,11 +109,16 @@ namespace OgreMayaExporter
 		std::vector<long> m_indices;
 		std::vector<vertex> m_vertices;
 		std::vector<face> m_faces;
+		std::vector<face> m_sharedFaces;
 		std::vector<uvset> m_uvsets;
 		bool m_use32bitIndexes;
+		bool m_exportColours;
+		bool m_buildTangents;
 		MDagPath m_dagPath;
 		BlendShape* m_pBlendShape;
 		MBoundingBox m_boundingBox;
+		Ogre::SubMesh* m_pOgreSubmesh;
+		std::vector<Ogre::VertexBoneAssignment> m_ogreBoneAssignments;
 	};
 
 }; // end of namespace
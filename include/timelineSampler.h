@@ -0,0 +1,124 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "timelineSampler.h"
+//! \brief Single pass sampler of the animation clips for Ogre Exporter.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+
+#ifndef _TIMELINESAMPLER_H
+#define _TIMELINESAMPLER_H
+
+#include "mayaExportLayer.h"
+#include "paramList.h"
+
+namespace OgreMayaExporter
+{
+	/***** kinds of data read at every sample *****/
+	typedef enum {SC_SKELETON,SC_VERTEX,SC_BLENDSHAPE,SC_BOUNDS} sampleChannel;
+
+	/***** Class SampleConsumer *****/
+	// Interface of the objects reading data from the scene at sampled times
+	class SampleConsumer
+	{
+	public:
+		//destructor
+		virtual ~SampleConsumer() {};
+		//called before the first sample is read
+		virtual MStatus beginSampling(ParamList& params) {return MS::kSuccess;};
+		//read the data of a clip key, the scene has already been evaluated at the key time
+		virtual MStatus sample(sampleChannel channel,int clip,int key,float clipTime,ParamList& params) = 0;
+		//called after the last sample has been read
+		virtual MStatus endSampling(ParamList& params) {return MS::kSuccess;};
+	};
+
+	/***** structure for a requested sample *****/
+	typedef struct sampleRequesttag
+	{
+		float time;					//scene time
+		float clipTime;				//time relative to the clip start
+		SampleConsumer* pConsumer;
+		sampleChannel channel;
+		int clip;					//clip id, as defined by the consumer
+		int key;					//index of the key in the clip
+	} sampleRequest;
+
+	/***** Class TimelineSampler *****/
+	// Collects the sample times of all clips and evaluates the scene only once
+	// for every distinct time, sending the evaluated frame to all the consumers
+	class TimelineSampler
+	{
+	public:
+		//constructor
+		TimelineSampler();
+		//destructor
+		~TimelineSampler();
+		//clear requested samples
+		void clear();
+		//check if any of the clips is sampled at the keys of its curves
+		static bool hasAutoRate(const std::vector<clipInfo>& clips);
+		//find the time based anim curves upstream of a node, adding them to curves if not already there.
+		//Driven key curves, whose input is another attribute, are only added if drivenKeys is true
+		static void findAnimCurves(const MObject& node,MObjectArray& curves,bool drivenKeys = false);
+		//get the sample times of a clip, fails if the clip range or rate are invalid. A negative
+		//rate samples at the keys of the given curves, and between keys where the curves
+		//deviate from a linear interpolation by more than tolerance
+		static MStatus getClipTimes(float start,float stop,float rate,const MObjectArray& curves,float tolerance,
+			std::vector<float>& times);
+		//request the samples of a clip
+		void addClip(SampleConsumer* pConsumer,sampleChannel channel,int clip,const std::vector<float>& times);
+		//evaluate the scene at all requested times
+		MStatus run(ParamList& params);
+
+	protected:
+		std::vector<sampleRequest> m_requests;
+	};
+
+}; // end of namespace
+
+#endif
@@ -0,0 +1,137 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "workerPool.h"
+//! \brief Worker thread pool for Ogre Exporter.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+
+#ifndef _WORKERPOOL_H
+#define _WORKERPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+
+namespace OgreMayaExporter
+{
+	/***** Class WorkerPool *****/
+	// Jobs queued on the pool may only use the Maya math value classes (MMatrix, MVector,
+	// MQuaternion and their operators), which work on their own members. Nodes, plugs,
+	// function sets, MString and MGlobal are only safe to use from the main thread.
+	// A pool with a single thread runs jobs inline.
+	// An exception thrown by a job is kept and rethrown by wait() on the calling thread.
+	class WorkerPool
+	{
+	public:
+		//constructor, 0 threads means one worker per hardware thread
+		WorkerPool(unsigned int numThreads = 0);
+		//destructor, waits for pending jobs
+		~WorkerPool();
+		//queue a job
+		void submit(const std::function<void()>& job);
+		//wait until all queued jobs have completed, rethrows the first exception thrown by a job
+		void wait();
+		//run job(i) for every i in [0,count) and wait for completion
+		void parallelFor(size_t count,const std::function<void(size_t)>& job);
+		//get number of worker threads
+		unsigned int numThreads() const;
+
+	protected:
+		//worker thread main loop
+		void workerLoop();
+		//run a job, keeping the first exception it throws
+		void runJob(const std::function<void()>& job);
+		//wait until all queued jobs have completed, without rethrowing
+		void waitIdle();
+
+		std::vector<std::thread> m_threads;
+		std::deque<std::function<void()> > m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_jobQueued;
+		std::condition_variable m_jobsDone;
+		size_t m_pendingJobs;
+		bool m_stop;
+		std::exception_ptr m_error;
+	};
+
+	/***** Class FramePipeline *****/
+	// Ring of frame slots shared by the main thread and a worker pool: the main thread
+	// captures the data of a frame into a free slot, then a worker processes it while
+	// the main thread moves on to the next frame. Slots are claimed and released through
+	// atomic flags, so the main thread only blocks when all slots are being processed.
+	class FramePipeline
+	{
+	public:
+		//constructor, 0 threads means one worker per hardware thread
+		FramePipeline(unsigned int numThreads = 0);
+		//destructor, waits for pending frames
+		~FramePipeline();
+		//get number of frame slots
+		unsigned int numSlots() const;
+		//claim the next free slot, waiting for a worker to release it if needed
+		unsigned int acquireSlot();
+		//process a captured slot on a worker, the slot is released when the job completes
+		void submit(unsigned int slot,const std::function<void()>& job);
+		//wait until all submitted frames have been processed, rethrows the first exception thrown by a job
+		void wait();
+
+	protected:
+		WorkerPool m_workers;
+		std::vector<std::atomic<bool> > m_busy;
+		unsigned int m_nextSlot;
+	};
+
+}; // end of namespace
+
+#endif
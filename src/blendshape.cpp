@@ -56,14 +56,31 @@
 
 #include "blendshape.h"
 #include "submesh.h"
+#include <algorithm>
 
 namespace OgreMayaExporter
 {
+	// map each Maya vertex to the exported vertices that refer to it
+	static void mapVertices(const std::vector<vertex>& vertices,long first,long count,std::vector<std::vector<long> >& vertexMap)
+	{
+		for (long i=first; i<first+count; i++)
+		{
+			long idx = vertices[i].index;
+			if (idx >= vertexMap.size())
+				vertexMap.resize(idx+1);
+			vertexMap[idx].push_back(i);
+		}
+	}
+
+	static bool offsetLess(const vertexOffset& a,const vertexOffset& b)
+	{
+		return a.index < b.index;
+	}
+
 	// Constructor
 	BlendShape::BlendShape()
 	{
 		m_pBlendShapeFn = NULL;
-		poseOptArray.clear();
 		clear();
 	}
 
@@ -135,6 +152,11 @@ namespace OgreMayaExporter
 		MStringArray poseNames;
 		MString cmd = "aliasAttr -q " + m_pBlendShapeFn->name();
 		MGlobal::executeCommand(cmd,poseNames,false,false);
+		// Map Maya vertices to exported vertices to apply the target deltas stored on the deformer
+		std::vector<std::vector<long> > vertexMap;
+		int numDirect = 0;
+		if (params.bsDirect)
+			mapVertices(vertices,offset,numVertices,vertexMap);
 		// Get all poses: set iteratively weight to 1 for current target shape and keep 0 for the other targets
 		for (int i=0; i<indexList.length(); i++)
 		{
@@ -153,6 +175,12 @@ namespace OgreMayaExporter
 					std::cout.flush();
 				}
 			}
+			// read the target deltas from the deformer, unless the target is a live shape
+			if (params.bsDirect && loadPoseDirect(meshDag,params,vertices,vertexMap,poseName,0,i,indexList[i]) == MS::kSuccess)
+			{
+				numDirect++;
+				continue;
+			}
 			// set weight to 1
 			stat = m_pBlendShapeFn->setWeight(indexList[i],1);
 			if (MS::kSuccess != stat)
@@ -187,6 +215,12 @@ namespace OgreMayaExporter
 		}
 		// Restore connections on weights
 		restoreConnections();
+		if (params.bsDirect)
+		{
+			std::cout << "Read " << numDirect << " of " << indexList.length() << " targets directly from blend shape deformer "
+				<< m_pBlendShapeFn->name().asChar() << "\n";
+			std::cout.flush();
+		}
 		return MS::kSuccess;
 	}
 
@@ -223,6 +257,11 @@ namespace OgreMayaExporter
 		poseGroup pg;
 		pg.targetIndex = targetIndex;
 		m_poseGroups.insert(std::pair<int,poseGroup>(targetIndex,pg));
+		// Map Maya vertices to exported vertices to apply the target deltas stored on the deformer
+		std::vector<std::vector<long> > vertexMap;
+		int numDirect = 0;
+		if (params.bsDirect)
+			mapVertices(vertices,0,vertices.size(),vertexMap);
 		for (int i=0; i<indexList.length(); i++)
 		{
 			MString poseName = "pose" + i;
@@ -241,6 +280,12 @@ namespace OgreMayaExporter
 					std::cout.flush();
 				}
 			}
+			// read the target deltas from the deformer, unless the target is a live shape
+			if (params.bsDirect && loadPoseDirect(meshDag,params,vertices,vertexMap,poseName,targetIndex,i,indexList[i]) == MS::kSuccess)
+			{
+				numDirect++;
+				continue;
+			}
 			// set weight to 1
 			stat = m_pBlendShapeFn->setWeight(indexList[i],1);
 			if (MS::kSuccess != stat)
@@ -275,6 +320,12 @@ namespace OgreMayaExporter
 		}
 		// Restore connections on weights
 		restoreConnections();
+		if (params.bsDirect)
+		{
+			std::cout << "Read " << numDirect << " of " << indexList.length() << " targets directly from blend shape deformer "
+				<< m_pBlendShapeFn->name().asChar() << "\n";
+			std::cout.flush();
+		}
 		return MS::kSuccess;
 	}
 
@@ -405,84 +456,145 @@ namespace OgreMayaExporter
 
 
 
-	// Load a blend shape animation track
-	Track BlendShape::loadTrack(float start,float stop,float rate,ParamList& params,int targetIndex,int startPoseId)
+	// Get the deltas of a blend shape target as stored on the deformer, without evaluating the mesh.
+	// Fails when the target is driven by a live shape, and returns kNotImplemented for targets applied
+	// after the other deformers (tangent or transform space), which have to be evaluated instead
+	MStatus BlendShape::getTargetDeltas(MDagPath& meshDag,int weightIndex,MIntArray& vertexIndices,MPointArray& deltas)
 	{
 		MStatus stat;
-		MString msg;
-		std::vector<float> times;
-		// Create a track for current clip
-		Track t;
-		t.m_type = TT_POSE;
-		t.m_target = m_target;
-		t.m_index = targetIndex;
-		t.m_vertexKeyframes.clear();
-		// Calculate times from clip sample rate
-		times.clear();
-		if (rate <= 0)
+		vertexIndices.clear();
+		deltas.clear();
+		unsigned int geomIndex = m_pBlendShapeFn->indexForOutputShape(meshDag.node(),&stat);
+		if (MS::kSuccess != stat)
+			return stat;
+		MPlug targetsPlug = m_pBlendShapeFn->findPlug("inputTarget",true).elementByLogicalIndex(geomIndex);
+		MPlug groupPlug = targetsPlug.child(m_pBlendShapeFn->attribute("inputTargetGroup")).elementByLogicalIndex(weightIndex);
+		// the stored deltas of post deformer targets are not in object space (the attribute is missing before Maya 2016.5)
+		MObject postModeAttr = m_pBlendShapeFn->attribute("postDeformersMode");
+		if (!postModeAttr.isNull())
 		{
-			std::cout << "invalid sample rate for the clip (must be >0), we skip it\n";
-			std::cout.flush();
-			return t;
+			int postMode = 0;
+			groupPlug.child(postModeAttr).getValue(postMode);
+			if (postMode != 0)
+				return MS::kNotImplemented;
+		}
+		// only the item at full weight counts at weight 1, in-betweens are ignored
+		MPlug itemsPlug = groupPlug.child(m_pBlendShapeFn->attribute("inputTargetItem"));
+		MIntArray itemIndices;
+		itemsPlug.getExistingArrayAttributeIndices(itemIndices);
+		bool foundItem = false;
+		for (int i=0; i<itemIndices.length(); i++)
+		{
+			if (itemIndices[i] == 6000)
+				foundItem = true;
 		}
-		for (float time=start; time<stop; time+=rate)
-			times.push_back(time);
-		times.push_back(stop);
-		// Get animation length
-		float length=0;
-		if (times.size() >= 0)
-			length = times[times.size()-1] - times[0];
-		if (length < 0)
+		if (!foundItem)
+			return MS::kFailure;
+		MPlug itemPlug = itemsPlug.elementByLogicalIndex(6000);
+		if (itemPlug.child(m_pBlendShapeFn->attribute("inputGeomTarget")).isConnected())
+			return MS::kFailure;
+		// sparse deltas and the vertices they apply to
+		MObject pointsData, componentsData;
+		stat = itemPlug.child(m_pBlendShapeFn->attribute("inputPointsTarget")).getValue(pointsData);
+		if (MS::kSuccess != stat)
+			return stat;
+		stat = itemPlug.child(m_pBlendShapeFn->attribute("inputComponentsTarget")).getValue(componentsData);
+		if (MS::kSuccess != stat)
+			return stat;
+		MFnPointArrayData pointsFn(pointsData,&stat);
+		if (MS::kSuccess != stat)
+			return stat;
+		deltas = pointsFn.array();
+		MFnComponentListData componentsFn(componentsData,&stat);
+		if (MS::kSuccess != stat)
+			return stat;
+		for (int i=0; i<componentsFn.length(); i++)
 		{
-			std::cout << "invalid time range for the clip, we skip it\n";
+			MFnSingleIndexedComponent componentFn(componentsFn[i]);
+			MIntArray elements;
+			componentFn.getElements(elements);
+			for (int j=0; j<elements.length(); j++)
+				vertexIndices.append(elements[j]);
+		}
+		if (vertexIndices.length() != deltas.length())
+			return MS::kFailure;
+		return MS::kSuccess;
+	}
+
+	// Load a single blend shape pose from the target deltas stored on the deformer
+	MStatus BlendShape::loadPoseDirect(MDagPath& meshDag,ParamList& params,std::vector<vertex>& vertices,
+		std::vector<std::vector<long> >& vertexMap,MString poseName,int targetIndex,int blendShapeIndex,int weightIndex)
+	{
+		MIntArray vertexIndices;
+		MPointArray deltas;
+		MStatus stat = getTargetDeltas(meshDag,weightIndex,vertexIndices,deltas);
+		if (MS::kNotImplemented == stat)
+		{
+			std::cout << "Warning: target " << poseName.asChar() << " of blend shape deformer " << m_pBlendShapeFn->name().asChar()
+				<< " is applied after the other deformers, evaluating it instead of reading its deltas\n";
 			std::cout.flush();
-			return t;
 		}
-		// Optimize Pose Animation
-		if (params.optimizePoseAnimation) {
-			std::cout << "Optimizing pose animation...\n";
-			int k = 0;
-			for (int i=0; i<times.size(); i++)
+		if (MS::kSuccess != stat)
+			return stat;
+		// get pose group
+		poseGroup& pg = m_poseGroups.find(targetIndex)->second;
+		// create a new pose
+		pose p;
+		p.poseTarget = m_target;
+		p.index = targetIndex;
+		p.blendShapeIndex = blendShapeIndex;
+		p.name = poseName.asChar();
+		// calculate vertex offsets, only for the vertices moved by the target
+		MMatrix matrix = meshDag.inclusiveMatrix();
+		for (int i=0; i<vertexIndices.length(); i++)
+		{
+			if (vertexIndices[i] < 0 || vertexIndices[i] >= vertexMap.size())
+				continue;
+			MVector delta(deltas[i].x,deltas[i].y,deltas[i].z);
+			if (params.exportWorldCoords)
+				delta = delta * matrix;
+			vertexOffset vo;
+			vo.x = delta.x * params.lum;
+			vo.y = delta.y * params.lum;
+			vo.z = delta.z * params.lum;
+			if (fabs(vo.x) < PRECISION)
+				vo.x = 0;
+			if (fabs(vo.y) < PRECISION)
+				vo.y = 0;
+			if (fabs(vo.z) < PRECISION)
+				vo.z = 0;
+			if ((vo.x==0) && (vo.y==0) && (vo.z==0))
+				continue;
+			std::vector<long>& mapped = vertexMap[vertexIndices[i]];
+			for (int j=0; j<mapped.size(); j++)
 			{
-				// Set time to wanted sample time
-				MAnimControl::setCurrentTime(MTime(times[i],MTime::kSeconds));            
-				poseOptArray.clear();
-				vertexKeyframe key = loadKeyframe(times[i]-times[0],params,targetIndex, startPoseId);
-				poseOptArray.setLength(key.poserefs.size());
-				// initialize poseOptArray
-				while (k==0) {
-					for (int j=0; j<key.poserefs.size(); j++) {
-						poseOptArray[j] = 0;
-						k = 1;
-					}
-				}
-				for (int j=0; j<key.poserefs.size(); j++) {
-					if (key.poserefs[j].poseWeight < -0.001 || key.poserefs[j].poseWeight > 0.001) poseOptArray[j] = 1;
-				}
-			}	
-			for (int j=0; j<poseOptArray.length(); j++) {
-				if (!poseOptArray[j])
-					std::cout << "pose num: " << j << " skipped (no animation found)\n";
-				else
-					std::cout << "pose num: " << j << " included (animation found)\n";
-			}			
+				vo.index = mapped[j];
+				p.offsets.push_back(vo);
+			}
 		}
-		// Evaluate animation curves at selected times
-		for (int i=0; i<times.size(); i++)
+		std::sort(p.offsets.begin(),p.offsets.end(),offsetLess);
+		// add pose to pose list
+		if (p.offsets.size() > 0)
+			pg.poses.push_back(p);
+		if (params.bsBB && p.offsets.size() > 0)
 		{
-			// Set time to wanted sample time
-			MAnimControl::setCurrentTime(MTime(times[i],MTime::kSeconds));
-			// Load a keyframe at current time
-			vertexKeyframe key = loadKeyframe(times[i]-times[0],params,targetIndex, startPoseId);
-			// Add keyframe to joint track
-			if (key.poserefs.size() > 0)
-				t.addVertexKeyframe(key);			
+			// update bounding boxes of the loaded submeshes of this mesh with the moved vertices
+			MBoundingBox bbox;
+			for (int i=0; i<p.offsets.size(); i++)
+			{
+				vertex& v = vertices[p.offsets[i].index];
+				bbox.expand(MPoint(v.x + p.offsets[i].x,v.y + p.offsets[i].y,v.z + p.offsets[i].z));
+			}
+			for (int i=0; i<params.loadedSubmeshes.size(); i++)
+			{
+				if (params.loadedSubmeshes[i]->m_dagPath == meshDag)
+					params.loadedSubmeshes[i]->m_boundingBox.expand(bbox);
+			}
 		}
-		// Clip successfully loaded
-		return t;
+		// pose loaded succesfully
+		return MS::kSuccess;
 	}
 
-
 	// Load a blend shape animation keyframe
 	vertexKeyframe BlendShape::loadKeyframe(float time,ParamList& params,int targetIndex, int startPoseId)
 	{
@@ -505,14 +617,80 @@ namespace OgreMayaExporter
 			vertexPoseRef poseref;
 			poseref.poseIndex = startPoseId + i;
 			poseref.poseWeight = envelope * m_pBlendShapeFn->weight(indexList[p.blendShapeIndex]);
-			if(poseOptArray.length() == 0)
-				key.poserefs.push_back(poseref);				
-			else if (poseOptArray[i] == 1) 						
-				key.poserefs.push_back(poseref);				
+			key.poserefs.push_back(poseref);
 		}
 		return key;
 	}
 
+	// Count the pose offsets of the exported vertices in [first,first+count), from the target deltas
+	// stored on the deformer. Only moved vertices get an offset, targets that can't be read directly
+	// are counted as moving every vertex
+	size_t BlendShape::countPoseOffsets(MDagPath& meshDag,const std::vector<vertex>& vertices,long first,long count)
+	{
+		std::vector<std::vector<long> > vertexMap;
+		mapVertices(vertices,first,count,vertexMap);
+		MIntArray indexList;
+		m_pBlendShapeFn->weightIndexList(indexList);
+		size_t numOffsets = 0;
+		for (int i=0; i<indexList.length(); i++)
+		{
+			MIntArray vertexIndices;
+			MPointArray deltas;
+			if (getTargetDeltas(meshDag,indexList[i],vertexIndices,deltas) != MS::kSuccess)
+			{
+				numOffsets += count;
+				continue;
+			}
+			for (int j=0; j<vertexIndices.length(); j++)
+			{
+				if (vertexIndices[j] < 0 || vertexIndices[j] >= vertexMap.size())
+					continue;
+				if (deltas[j].x != 0 || deltas[j].y != 0 || deltas[j].z != 0)
+					numOffsets += vertexMap[vertexIndices[j]].size();
+			}
+		}
+		return numOffsets;
+	}
+
+	// Remove references to poses that are never animated in a track
+	void BlendShape::optimiseTrack(Track& t)
+	{
+		std::cout << "Optimizing pose animation...\n";
+		// find the poses with a non zero weight in at least one keyframe
+		std::set<int> animatedPoses;
+		std::set<int> allPoses;
+		for (int i=0; i<t.m_vertexKeyframes.size(); i++)
+		{
+			vertexKeyframe& key = t.m_vertexKeyframes[i];
+			for (int j=0; j<key.poserefs.size(); j++)
+			{
+				allPoses.insert(key.poserefs[j].poseIndex);
+				if (key.poserefs[j].poseWeight < -0.001 || key.poserefs[j].poseWeight > 0.001)
+					animatedPoses.insert(key.poserefs[j].poseIndex);
+			}
+		}
+		for (std::set<int>::iterator it = allPoses.begin(); it != allPoses.end(); it++)
+		{
+			if (animatedPoses.find(*it) == animatedPoses.end())
+				std::cout << "pose num: " << *it << " skipped (no animation found)\n";
+			else
+				std::cout << "pose num: " << *it << " included (animation found)\n";
+		}
+		std::cout.flush();
+		// remove the references to the other poses
+		for (int i=0; i<t.m_vertexKeyframes.size(); i++)
+		{
+			std::vector<vertexPoseRef> poserefs;
+			vertexKeyframe& key = t.m_vertexKeyframes[i];
+			for (int j=0; j<key.poserefs.size(); j++)
+			{
+				if (animatedPoses.find(key.poserefs[j].poseIndex) != animatedPoses.end())
+					poserefs.push_back(key.poserefs[j]);
+			}
+			key.poserefs.swap(poserefs);
+		}
+	}
+
 	// Get blend shape deformer name
 	MString BlendShape::getName()
 	{
@@ -91,6 +91,7 @@ namespace OgreMayaExporter
 		m_specular = MColor(0,0,0,0);
 		m_emissive = MColor(0,0,0,0);
 		m_textures.clear();
+		m_hasNormalMap = false;
 	}
 
 
@@ -254,6 +255,10 @@ namespace OgreMayaExporter
 			}
 		}
 
+		// Look for a normal map
+		if (m_type != MT_SURFACE_SHADER && m_type != MT_CGFX)
+			loadNormalMap(pShader,uvsets,params);
+
 		return MS::kSuccess;
 	}
 
@@ -462,6 +467,18 @@ namespace OgreMayaExporter
 	MStatus Material::loadTexture(MFnDependencyNode* pTexNode,TexOpType& opType,MStringArray& uvsets,ParamList& params)
 	{
 		Texture tex;
+		MStatus stat = readTexture(pTexNode,opType,uvsets,params,tex);
+		if (MS::kSuccess != stat)
+			return stat;
+		// add texture to material texture list
+		m_textures.push_back(tex);
+		return MS::kSuccess;
+	}
+
+
+	// Read texture data from a texture node
+	MStatus Material::readTexture(MFnDependencyNode* pTexNode,TexOpType& opType,MStringArray& uvsets,ParamList& params,Texture& tex)
+	{
 		// Get texture filename
 		MString filename, absFilename;
 		MRenderUtil::exactFileTextureName(pTexNode->object(),absFilename);
@@ -582,8 +599,6 @@ namespace OgreMayaExporter
 			if (fabs(rot) < PRECISION)
 				tex.rot = 0;
 		}
-		// add texture to material texture list
-		m_textures.push_back(tex);
 		// free up memory
 		if (pUvChooserNode)
 			delete pUvChooserNode;
@@ -594,6 +609,51 @@ namespace OgreMayaExporter
 	}
 
 
+	// Look for a normal or bump map connected to the shader through a bump2d node
+	MStatus Material::loadNormalMap(MFnDependencyNode* pShader,MStringArray& uvsets,ParamList& params)
+	{
+		MStatus stat;
+		MPlugArray bumpSrcPlugs;
+		MPlug normalCameraPlug = pShader->findPlug("normalCamera",true,&stat);
+		if (MS::kSuccess != stat)
+			return MS::kSuccess;
+		normalCameraPlug.connectedTo(bumpSrcPlugs,true,false);
+		for (int i=0; i<bumpSrcPlugs.length() && !m_hasNormalMap; i++)
+		{
+			if (!bumpSrcPlugs[i].node().hasFn(MFn::kBump))
+				continue;
+			MFnDependencyNode bumpNode(bumpSrcPlugs[i].node());
+			// bump interpolation: 0 = bump, 1 = tangent space normals, 2 = object space normals
+			short bumpInterp = 0;
+			bumpNode.findPlug("bumpInterp",true).getValue(bumpInterp);
+			if (bumpInterp == 2)
+				continue;
+			MPlugArray texSrcPlugs;
+			bumpNode.findPlug("bumpValue",true).connectedTo(texSrcPlugs,true,false);
+			for (int j=0; j<texSrcPlugs.length() && !m_hasNormalMap; j++)
+			{
+				if (texSrcPlugs[j].node().hasFn(MFn::kFileTexture))
+				{
+					MFnDependencyNode textureNode(texSrcPlugs[j].node());
+					TexOpType opType = TOT_MODULATE;
+					stat = readTexture(&textureNode,opType,uvsets,params,m_normalMap);
+					if (MS::kSuccess == stat)
+						m_hasNormalMap = true;
+				}
+			}
+		}
+		return MS::kSuccess;
+	}
+
+
+	// Check if the material samples a normal map in tangent space. CgFX shaders are
+	// opaque to the exporter, so they are assumed to need tangents
+	bool Material::needsTangents()
+	{
+		return m_hasNormalMap || m_type == MT_CGFX;
+	}
+
+
 	// Write material data to an Ogre material script file
 	MStatus Material::writeOgreScript(ParamList &params)
 	{
@@ -0,0 +1,210 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "matrixKernel.cpp"
+//! \brief Batched decomposition of transformation matrices for Ogre Exporter.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+
+#include "matrixKernel.h"
+#include <math.h>
+
+namespace OgreMayaExporter
+{
+	// c = a x b
+	static inline void cross(const double a[3],const double b[3],double c[3])
+	{
+		c[0] = a[1]*b[2] - a[2]*b[1];
+		c[1] = a[2]*b[0] - a[0]*b[2];
+		c[2] = a[0]*b[1] - a[1]*b[0];
+	}
+
+	// resize all arrays
+	void decomposedMatricesTag::resize(size_t count)
+	{
+		tx.resize(count); ty.resize(count); tz.resize(count);
+		qx.resize(count); qy.resize(count); qz.resize(count); qw.resize(count);
+		sx.resize(count); sy.resize(count); sz.resize(count);
+		shxy.resize(count); shxz.resize(count); shyz.resize(count);
+	}
+
+	// Decompose an array of matrices
+	void decomposeMatrices(const double (*matrices)[4][4],size_t count,decomposedMatrices& out)
+	{
+		out.resize(count);
+		for (size_t i=0; i<count; i++)
+		{
+			const double (&m)[4][4] = matrices[i];
+			// the upper 3x3 is S * Sh * R, with the shear matrix lower triangular,
+			// so the rows are orthonormalised starting from the first one
+			double r0[3] = {m[0][0],m[0][1],m[0][2]};
+			double r1[3] = {m[1][0],m[1][1],m[1][2]};
+			double r2[3] = {m[2][0],m[2][1],m[2][2]};
+			double sx = sqrt(r0[0]*r0[0] + r0[1]*r0[1] + r0[2]*r0[2]);
+			double inv = sx > 0 ? 1.0 / sx : 0;
+			r0[0] *= inv; r0[1] *= inv; r0[2] *= inv;
+			double d01 = r1[0]*r0[0] + r1[1]*r0[1] + r1[2]*r0[2];
+			r1[0] -= d01*r0[0]; r1[1] -= d01*r0[1]; r1[2] -= d01*r0[2];
+			double sy = sqrt(r1[0]*r1[0] + r1[1]*r1[1] + r1[2]*r1[2]);
+			inv = sy > 0 ? 1.0 / sy : 0;
+			r1[0] *= inv; r1[1] *= inv; r1[2] *= inv;
+			double d02 = r2[0]*r0[0] + r2[1]*r0[1] + r2[2]*r0[2];
+			double d12 = r2[0]*r1[0] + r2[1]*r1[1] + r2[2]*r1[2];
+			r2[0] -= d02*r0[0] + d12*r1[0]; r2[1] -= d02*r0[1] + d12*r1[1]; r2[2] -= d02*r0[2] + d12*r1[2];
+			double sz = sqrt(r2[0]*r2[0] + r2[1]*r2[1] + r2[2]*r2[2]);
+			inv = sz > 0 ? 1.0 / sz : 0;
+			r2[0] *= inv; r2[1] *= inv; r2[2] *= inv;
+			out.shxy[i] = sy > 0 ? d01 / sy : 0;
+			out.shxz[i] = sz > 0 ? d02 / sz : 0;
+			out.shyz[i] = sz > 0 ? d12 / sz : 0;
+			// axes with a zero scale leave zero rows, complete the basis so the rotation stays valid
+			double* rows[3] = {r0,r1,r2};
+			double scales[3] = {sx,sy,sz};
+			int numZero = 0, zero = 0, valid = 0;
+			for (int k=0; k<3; k++)
+			{
+				if (scales[k] == 0)
+				{
+					numZero++;
+					zero = k;
+				}
+				else
+					valid = k;
+			}
+			if (numZero == 1)
+				cross(rows[(zero+1)%3],rows[(zero+2)%3],rows[zero]);
+			else if (numZero == 2)
+			{
+				// any unit vector orthogonal to the remaining row, built from the axis least aligned with it
+				const double* a = rows[valid];
+				int axis = 0;
+				for (int k=1; k<3; k++)
+				{
+					if (fabs(a[k]) < fabs(a[axis]))
+						axis = k;
+				}
+				double* b = rows[(valid+1)%3];
+				for (int k=0; k<3; k++)
+					b[k] = (k == axis ? 1 : 0) - a[axis]*a[k];
+				double len = sqrt(b[0]*b[0] + b[1]*b[1] + b[2]*b[2]);
+				b[0] /= len; b[1] /= len; b[2] /= len;
+				cross(a,b,rows[(valid+2)%3]);
+			}
+			else if (numZero == 3)
+			{
+				for (int k=0; k<3; k++)
+				{
+					r0[k] = (k == 0); r1[k] = (k == 1); r2[k] = (k == 2);
+				}
+			}
+			// a negative determinant is treated as a negative scale on all axes
+			double det = r2[0]*(r0[1]*r1[2] - r0[2]*r1[1]) + r2[1]*(r0[2]*r1[0] - r0[0]*r1[2]) + r2[2]*(r0[0]*r1[1] - r0[1]*r1[0]);
+			if (det < 0)
+			{
+				sx = -sx; sy = -sy; sz = -sz;
+				for (int k=0; k<3; k++)
+				{
+					r0[k] = -r0[k]; r1[k] = -r1[k]; r2[k] = -r2[k];
+				}
+			}
+			out.tx[i] = m[3][0];
+			out.ty[i] = m[3][1];
+			out.tz[i] = m[3][2];
+			out.sx[i] = sx;
+			out.sy[i] = sy;
+			out.sz[i] = sz;
+			// quaternion from the rotation rows, using the largest diagonal term for precision
+			double qx,qy,qz,qw;
+			double t0 = 1 + r0[0] + r1[1] + r2[2];
+			double t1 = 1 + r0[0] - r1[1] - r2[2];
+			double t2 = 1 - r0[0] + r1[1] - r2[2];
+			double t3 = 1 - r0[0] - r1[1] + r2[2];
+			if (t0 >= t1 && t0 >= t2 && t0 >= t3)
+			{
+				double s = 0.5 / sqrt(t0);
+				qw = 0.25 / s;
+				qx = (r1[2] - r2[1]) * s;
+				qy = (r2[0] - r0[2]) * s;
+				qz = (r0[1] - r1[0]) * s;
+			}
+			else if (t1 >= t2 && t1 >= t3)
+			{
+				double s = 0.5 / sqrt(t1);
+				qx = 0.25 / s;
+				qw = (r1[2] - r2[1]) * s;
+				qy = (r0[1] + r1[0]) * s;
+				qz = (r2[0] + r0[2]) * s;
+			}
+			else if (t2 >= t3)
+			{
+				double s = 0.5 / sqrt(t2);
+				qy = 0.25 / s;
+				qw = (r2[0] - r0[2]) * s;
+				qx = (r0[1] + r1[0]) * s;
+				qz = (r1[2] + r2[1]) * s;
+			}
+			else
+			{
+				double s = 0.5 / sqrt(t3);
+				qz = 0.25 / s;
+				qw = (r0[1] - r1[0]) * s;
+				qx = (r2[0] + r0[2]) * s;
+				qy = (r1[2] + r2[1]) * s;
+			}
+			if (qw < 0)
+			{
+				qx = -qx; qy = -qy; qz = -qz; qw = -qw;
+			}
+			out.qx[i] = qx;
+			out.qy[i] = qy;
+			out.qz[i] = qz;
+			out.qw[i] = qw;
+		}
+	}
+
+}; //end of namespace
@@ -56,8 +56,11 @@
 
 
 #include "mesh.h"
+#include "binaryData.h"
 #include <maya/MFnMatrixData.h>
 #include <OgreResource.h>
+#include <OgreTangentSpaceCalc.h>
+#include <algorithm>
 
 namespace OgreMayaExporter
 {
@@ -72,6 +75,7 @@ namespace OgreMayaExporter
 		m_sharedGeom.dagMap.clear();
 		m_vertexClips.clear();
 		m_BSClips.clear();
+		m_exportSharedColours = false;
 	}
 
 	// destructor
@@ -96,12 +100,15 @@ namespace OgreMayaExporter
 		m_sharedGeom.dagMap.clear();
 		m_vertexClips.clear();
 		m_BSClips.clear();
+		m_BSSources.clear();
+		m_BSSampledClips.clear();
 		m_uvsets.clear();
 		m_submeshes.clear();
 		if (m_pSkeleton)
 			delete m_pSkeleton;
 		m_pSkeleton = NULL;
 		m_poseRemapping.clear();
+		m_exportSharedColours = false;
 	}
 
 	// get pointer to linked skeleton
@@ -139,7 +146,7 @@ namespace OgreMayaExporter
 		pBlendShape = NULL;
 
 		// Get mesh uvsets
-		stat = getUVSets(meshDag);		
+		stat = getUVSets(meshDag,params);		
 		if (stat != MS::kSuccess)
 		{
 			std::cout << "Error retrieving uvsets for current mesh\n";
@@ -179,9 +186,9 @@ namespace OgreMayaExporter
 			std::cout.flush();
 		}
 		// Get vertex bone weights
-		if (pSkinCluster)
+		if (pSkinCluster && (params.vertexAttributes & VA_BLENDWEIGHTS))
 		{
-			getVertexBoneWeights(meshDag,params);
+			stat = getVertexBoneWeights(meshDag,params);
 			if (stat != MS::kSuccess)
 			{
 				std::cout << "Error retrieving veretex bone assignements for current mesh\n";
@@ -195,8 +202,8 @@ namespace OgreMayaExporter
 			std::cout << "Error retrieving faces data for current mesh\n";
 			std::cout.flush();
 		}
-		// Build shared geometry
-		if (params.useSharedGeom)
+		// Build shared geometry (when choosing the layout automatically both layouts are built)
+		if (params.useSharedGeom || params.autoSharedGeom)
 		{
 			stat = buildSharedGeometry(meshDag,params);
 			if (stat != MS::kSuccess)
@@ -238,39 +245,125 @@ namespace OgreMayaExporter
 	/*******************************************************************************
 	 *                    Load mesh animations from Maya                           *
 	 *******************************************************************************/
-	// Load vertex animations
+	// Load skeleton, vertex and blend shape animations. All clips are sampled together,
+	// so every sampled time is evaluated only once
 	MStatus Mesh::loadAnims(ParamList& params)
 	{
 		MStatus stat;
-		// save current time for later restore
-		MTime curTime = MAnimControl::currentTime();
-		std::cout << "Loading vertex animations...\n";
+		TimelineSampler sampler;
+		// register all clips with the sampler
+		if (params.exportVertAnims)
+			registerVertexAnims(sampler,params);
+		if (params.exportBlendShapes && params.exportBSAnims)
+			registerBlendShapeAnims(sampler,params);
+		if (m_pSkeleton && params.exportSkelAnims)
+		{
+			m_pSkeleton->registerAnims(sampler,params);
+			// update the submeshes bounding boxes at the skeleton clips keys
+			if (params.skelBB)
+			{
+				// the cache only holds keyframes, the skinned vertices of cached clips are still evaluated
+				if (params.animCacheFile != "")
+					MGlobal::displayWarning("-skelBB evaluates every skeleton clip in Maya, including the ones read from -animCache");
+				MObjectArray curves;
+				if (TimelineSampler::hasAutoRate(params.skelClipList))
+					m_pSkeleton->findAnimCurves(curves);
+				for (int i=0; i<params.skelClipList.size(); i++)
+				{
+					clipInfo ci = params.skelClipList[i];
+					std::vector<float> times;
+					if (TimelineSampler::getClipTimes(ci.start,ci.stop,ci.rate,curves,params.autoRateTolerance,times) == MS::kSuccess)
+						sampler.addClip(this,SC_BOUNDS,i,times);
+				}
+			}
+		}
+		// sample the timeline
+		std::cout << "Sampling animations...\n";
 		std::cout.flush();
-		// clear animations data
-		m_vertexClips.clear();
-		// load the requested clips
-		for (int i=0; i<params.vertClipList.size(); i++)
+		stat = sampler.run(params);
+		// complete the loaded animations
+		if (params.exportVertAnims)
 		{
-			std::cout << "Loading clip " << params.vertClipList[i].name.asChar() << "\n";
-			std::cout.flush();
-			stat = loadClip(params.vertClipList[i].name,params.vertClipList[i].start,
-				params.vertClipList[i].stop,params.vertClipList[i].rate,params);
-			if (stat == MS::kSuccess)
+			for (int i=0; i<m_vertexClips.size(); i++)
 			{
-				std::cout << "Clip successfully loaded\n";
+				std::cout << "clip " << m_vertexClips[i].m_name.asChar() << "\n";
+				std::cout << "length: " << m_vertexClips[i].m_length << "\n";
+				std::cout << "num keyframes: " << m_vertexClips[i].m_tracks[0].m_vertexKeyframes.size() << "\n";
 				std::cout.flush();
 			}
-			else
+		}
+		if (params.exportBlendShapes && params.exportBSAnims)
+			finaliseBlendShapeAnims(params);
+		if (m_pSkeleton && params.exportSkelAnims)
+		{
+			// create the LOD variants from the sampled keyframes, before they are reduced
+			if (params.animLods.size() > 0)
 			{
-				std::cout << "Failed loading clip\n";
-				std::cout.flush();
+				std::vector<float> weights;
+				getJointWeights(weights);
+				m_pSkeleton->createLodAnims(weights,params);
 			}
+			m_pSkeleton->finaliseAnims(params);
 		}
-		//restore current time
-		MAnimControl::setCurrentTime(curTime);
-		return MS::kSuccess;
+		return stat;
 	}
 
+	// Read animation data for a clip at current time
+	MStatus Mesh::sample(sampleChannel channel,int clip,int key,float clipTime,ParamList& params)
+	{
+		MStatus stat = MS::kSuccess;
+		switch (channel)
+		{
+		case SC_VERTEX:
+			{
+				Animation& a = m_vertexClips[clip];
+				// a single track for the whole mesh when using shared geometry, else a track for each submesh
+				if (params.useSharedGeom)
+					stat = loadKeyframe(a.m_tracks[0],clipTime,params);
+				else
+				{
+					for (int j=0; j<m_submeshes.size(); j++)
+					{
+						if (m_submeshes[j]->loadKeyframe(a.m_tracks[j],clipTime,params) != MS::kSuccess)
+							stat = MS::kFailure;
+					}
+				}
+			}
+			break;
+		case SC_BLENDSHAPE:
+			{
+				Animation& a = m_BSSampledClips[clip];
+				for (int j=0; j<m_BSSources.size(); j++)
+				{
+					blendShapeSource& bs = m_BSSources[j];
+					vertexKeyframe k = bs.pBlendShape->loadKeyframe(clipTime,params,bs.targetIndex,bs.startPoseId);
+					a.m_tracks[j].addVertexKeyframe(k);
+				}
+			}
+			break;
+		case SC_BOUNDS:
+			{
+				// update bounding boxes of loaded submeshes
+				for (int j=0; j<params.loadedSubmeshes.size(); j++)
+				{
+					MFnMesh mesh(params.loadedSubmeshes[j]->m_dagPath);
+					MPoint min = mesh.boundingBox().min();
+					MPoint max = mesh.boundingBox().max();
+					MBoundingBox bbox(min,max);
+					if (params.exportWorldCoords)
+						bbox.transformUsing(params.loadedSubmeshes[j]->m_dagPath.inclusiveMatrix());
+					min = bbox.min() * params.lum;
+					max = bbox.max() * params.lum;
+					MBoundingBox newbbox(min,max);
+					params.loadedSubmeshes[j]->m_boundingBox.expand(newbbox);
+				}
+			}
+			break;
+		default:
+			break;
+		}
+		return stat;
+	}
 
 
 	// Load blend shape deformers
@@ -341,93 +434,139 @@ namespace OgreMayaExporter
 					pSubmesh->m_pBlendShape->restoreEnvelope();
 			}
 		}
-		// Read blend shape animations
-		if (params.exportBSAnims)
-		{
-			stat = loadBlendShapeAnimations(params);
-		}
 		return MS::kSuccess;
 	}
 
-	// Load blend shape animations
-	MStatus Mesh::loadBlendShapeAnimations(ParamList& params)
+	// Register blend shape animation clips with the timeline sampler
+	MStatus Mesh::registerBlendShapeAnims(TimelineSampler& sampler,ParamList& params)
 	{
 		std::cout << "Loading blend shape animations...\n";
 		std::cout.flush();
-		// Read the list of blend shape clips to export
-		for (int i=0; i<params.BSClipList.size(); i++)
+		// list the blend shapes read by every keyframe
+		m_BSSources.clear();
+		m_BSSampledClips.clear();
+		m_BSClips.clear();
+		if (params.useSharedGeom)
 		{
 			int startPoseId = 0;
+			for (int i=0; i<m_sharedGeom.dagMap.size(); i++)
+			{
+				dagInfo di = m_sharedGeom.dagMap[i];
+				if (di.pBlendShape)
+				{
+					blendShapeSource bs;
+					bs.pBlendShape = di.pBlendShape;
+					bs.targetType = T_MESH;
+					bs.targetIndex = 0;
+					bs.startPoseId = startPoseId;
+					m_BSSources.push_back(bs);
+					startPoseId += di.pBlendShape->getPoseGroups().find(0)->second.poses.size();
+				}
+			}
+		}
+		else
+		{
+			for (int i=0; i<m_submeshes.size(); i++)
+			{
+				if (m_submeshes[i]->m_pBlendShape)
+				{
+					blendShapeSource bs;
+					bs.pBlendShape = m_submeshes[i]->m_pBlendShape;
+					bs.targetType = T_SUBMESH;
+					bs.targetIndex = i+1;
+					bs.startPoseId = 0;
+					m_BSSources.push_back(bs);
+				}
+			}
+		}
+		if (m_BSSources.size() <= 0)
+			return MS::kSuccess;
+		// curves driving the blend shape weights, for clips sampled at their keys
+		MObjectArray curves;
+		if (TimelineSampler::hasAutoRate(params.BSClipList))
+		{
+			for (int i=0; i<m_BSSources.size(); i++)
+				TimelineSampler::findAnimCurves(m_BSSources[i].pBlendShape->m_pBlendShapeFn->object(),curves);
+		}
+		// create a track for each blend shape in every clip
+		for (int i=0; i<params.BSClipList.size(); i++)
+		{
 			clipInfo ci = params.BSClipList[i];
-			// Create a new animation for every clip
+			std::cout << "clip " << ci.name.asChar() << "\n";
+			std::cout.flush();
+			std::vector<float> times;
+			if (TimelineSampler::getClipTimes(ci.start,ci.stop,ci.rate,curves,params.autoRateTolerance,times) != MS::kSuccess)
+				continue;
 			Animation a;
 			a.m_name = ci.name;
-			a.m_length = ci.stop - ci.start;
+			a.m_length = times[times.size()-1] - times[0];
+			for (int j=0; j<m_BSSources.size(); j++)
+			{
+				Track t;
+				t.m_type = TT_POSE;
+				t.m_target = m_BSSources[j].targetType;
+				t.m_index = m_BSSources[j].targetIndex;
+				t.m_vertexKeyframes.reserve(times.size());
+				a.addTrack(t);
+			}
+			m_BSSampledClips.push_back(a);
+			sampler.addClip(this,SC_BLENDSHAPE,m_BSSampledClips.size()-1,times);
+		}
+		return MS::kSuccess;
+	}
+
+	// Build the blend shape animations from the sampled weights
+	MStatus Mesh::finaliseBlendShapeAnims(ParamList& params)
+	{
+		for (int i=0; i<m_BSSampledClips.size(); i++)
+		{
+			Animation& sampled = m_BSSampledClips[i];
+			// Skip poses that are never animated in the clip
+			if (params.optimizePoseAnimation)
+			{
+				for (int j=0; j<sampled.m_tracks.size(); j++)
+					m_BSSources[j].pBlendShape->optimiseTrack(sampled.m_tracks[j]);
+			}
+			Animation a;
+			a.m_name = sampled.m_name;
+			a.m_length = sampled.m_length;
 			a.m_tracks.clear();
-			std::cout << "clip " << ci.name.asChar() << "\n";
-			// Read animation tracks from the blend shape deformer
+			std::vector<Track> tracks;
 			if (params.useSharedGeom)
 			{
-				// Create a track for each blend shape
-				std::vector<Track> tracks;
-				for  (int j=0; j<m_sharedGeom.dagMap.size(); j++)
+				// Merge keyframes at the same time position from all tracks
+				// (shared geometry must have a single animation track)
+				Track newTrack;
+				newTrack.m_type = TT_POSE;
+				newTrack.m_target = T_MESH;
+				for (int j=0; j<sampled.m_tracks[0].m_vertexKeyframes.size(); j++)
 				{
-					dagInfo di = m_sharedGeom.dagMap[j];
-					if (di.pBlendShape)
+					vertexKeyframe newKeyframe;
+					newKeyframe.time = sampled.m_tracks[0].m_vertexKeyframes[j].time;
+					for (int k=0; k<sampled.m_tracks.size(); k++)
 					{
-						Track t = di.pBlendShape->loadTrack(ci.start,ci.stop,ci.rate,params,0,startPoseId);
-						tracks.push_back(t);
-						startPoseId += di.pBlendShape->getPoseGroups().find(0)->second.poses.size();
+						std::vector<vertexPoseRef>& poserefs = sampled.m_tracks[k].m_vertexKeyframes[j].poserefs;
+						newKeyframe.poserefs.insert(newKeyframe.poserefs.end(),poserefs.begin(),poserefs.end());
 					}
+					newTrack.m_vertexKeyframes.push_back(newKeyframe);
 				}
-				// Merge the tracks into a single track (shared geometry must have a single animation track)
-				if (tracks.size() > 0)
-				{
-					Track newTrack;
-					// Merge keyframes at the same time position from all tracks
-					for (int j=0; j<tracks[0].m_vertexKeyframes.size(); j++)
-					{
-						// Create a new keyframe
-						vertexKeyframe newKeyframe;
-						newKeyframe.time = tracks[0].m_vertexKeyframes[j].time;
-						// Get keyframe at current position from all tracks
-						for (int k=0; k<tracks.size(); k++)
-						{
-							vertexKeyframe* pSrcKeyframe = &tracks[k].m_vertexKeyframes[j];
-							// Add pose references from this keyframe to the new keyframe for the joined track
-							for (int pri=0; pri<pSrcKeyframe->poserefs.size(); pri++)
-							{
-								// Create a new pose reference
-								vertexPoseRef poseref;
-								// Copy pose reference settings from source keyframe
-								poseref.poseIndex = pSrcKeyframe->poserefs[pri].poseIndex;
-								poseref.poseWeight = pSrcKeyframe->poserefs[pri].poseWeight;
-								// Add the new pose reference to the new keyframe
-								newKeyframe.poserefs.push_back(poseref);
-							}
-						}
-						// Add the keyframe to the new joined track
-						newTrack.m_vertexKeyframes.push_back(newKeyframe);
-					}
-					// Add the joined track to current animation clip
-					a.addTrack(newTrack);
-				}
+				tracks.push_back(newTrack);
 			}
 			else
+				tracks = sampled.m_tracks;
+			// Keyframes without pose references are not exported
+			for (int j=0; j<tracks.size(); j++)
 			{
-				// Create a track for each submesh
-				std::vector<Track> tracks;
-				for (int j=0; j<m_submeshes.size(); j++)
+				Track t = tracks[j];
+				t.m_vertexKeyframes.clear();
+				for (int k=0; k<tracks[j].m_vertexKeyframes.size(); k++)
 				{
-					Submesh* pSubmesh = m_submeshes[j];
-					if (pSubmesh->m_pBlendShape)
-					{
-						int startPoseId = 0;
-						Track t = pSubmesh->m_pBlendShape->loadTrack(ci.start,ci.stop,ci.rate,params,j+1,startPoseId);
-						a.addTrack(t);
-					}
+					if (tracks[j].m_vertexKeyframes[k].poserefs.size() > 0)
+						t.addVertexKeyframe(tracks[j].m_vertexKeyframes[k]);
 				}
+				a.addTrack(t);
 			}
+			std::cout << "clip " << a.m_name.asChar() << "\n";
 			if (a.m_tracks.size() > 0)
 			{
 				std::cout << "length: " << a.m_length << "\n";
@@ -441,13 +580,14 @@ namespace OgreMayaExporter
 				std::cout.flush();
 			}
 		}
+		m_BSSampledClips.clear();
 		return MS::kSuccess;
 	}
 
 
 /******************** Methods to parse geometry data from Maya ************************/
 	// Get uvsets info from the maya mesh
-	MStatus Mesh::getUVSets(const MDagPath& meshDag)
+	MStatus Mesh::getUVSets(const MDagPath& meshDag,ParamList& params)
 	{
 		MFnMesh mesh(meshDag);
 		MStatus stat;
@@ -462,7 +602,9 @@ namespace OgreMayaExporter
 				return MS::kFailure;
 			}
 		}
-		// Save uvsets info
+		// Save uvsets info (uvset names are still needed to link materials to uvsets)
+		if (!(params.vertexAttributes & VA_TEXCOORD))
+			return MS::kSuccess;
 		for (int i=m_uvsets.size(); i<newuvsets.length(); i++)
 		{
 			uvset uv;
@@ -605,10 +747,13 @@ namespace OgreMayaExporter
 		else
 			mesh.getPoints(newpoints,MSpace::kTransform);
 		//get list of normals from mesh data
-		if (params.exportWorldCoords)
-			mesh.getNormals(newnormals,MSpace::kWorld);
-		else
-			mesh.getNormals(newnormals,MSpace::kTransform);
+		if (params.vertexAttributes & VA_NORMAL)
+		{
+			if (params.exportWorldCoords)
+				mesh.getNormals(newnormals,MSpace::kWorld);
+			else
+				mesh.getNormals(newnormals,MSpace::kTransform);
+		}
 		//check the "opposite" attribute to see if we have to flip normals
 		mesh.findPlug("opposite",true).getValue(opposite);
 		return MS::kSuccess;
@@ -622,6 +767,21 @@ namespace OgreMayaExporter
 		MStatus stat;
 		std::cout << "Get vbas\n";
 		std::cout.flush();
+		// map the influence objects to the skeleton joints
+		std::vector<int> influenceJoints;
+		if (m_pSkeleton)
+		{
+			MDagPathArray influenceObjs;
+			pSkinCluster->influenceObjects(influenceObjs,&stat);
+			if (MS::kSuccess != stat)
+			{
+				std::cout << "Error retrieving influence objects for given skin cluster\n";
+				std::cout.flush();
+			}
+			influenceJoints.resize(influenceObjs.length());
+			for (int j=0; j<influenceObjs.length(); j++)
+				influenceJoints[j] = m_pSkeleton->getJointIndex(influenceObjs[j].partialPathName());
+		}
 		MItGeometry iterGeom(meshDag);
 		for (int i=0; !iterGeom.isDone(); iterGeom.next(), i++)
 		{
@@ -638,26 +798,11 @@ namespace OgreMayaExporter
 			// get ids for the joints
 			if (m_pSkeleton)
 			{
-				MDagPathArray influenceObjs;
-				pSkinCluster->influenceObjects(influenceObjs,&stat);
-				if (MS::kSuccess != stat)
-				{
-					std::cout << "Error retrieving influence objects for given skin cluster\n";
-					std::cout.flush();
-				}
 				newjointIds[i].setLength(newweights[i].length());
-				for (int j=0; j<influenceObjs.length(); j++)
+				for (int j=0; j<influenceJoints.size(); j++)
 				{
-					bool foundJoint = false;
-					MString partialPathName = influenceObjs[j].partialPathName(); 
-					for (int k=0; k<m_pSkeleton->getJoints().size() && !foundJoint; k++)
-					{
-						if (partialPathName == m_pSkeleton->getJoints()[k].name)
-						{
-							foundJoint=true;
-							newjointIds[i][j] = m_pSkeleton->getJoints()[k].id;
-						}
-					}
+					if (influenceJoints[j] >= 0)
+						newjointIds[i][j] = influenceJoints[j];
 				}
 			}
 		}
@@ -670,6 +815,14 @@ namespace OgreMayaExporter
 	{
 		MStatus stat;
 		MFnMesh mesh(meshDag);
+		// vertices are never split on position only exports, so read the triangulation directly
+		if (!(params.vertexAttributes & (VA_NORMAL | VA_COLOUR | VA_TEXCOORD)))
+			return getTriangles(meshDag,params);
+		// vertex indices in faces refer to the shared vertex buffer when using shared geometry
+		long vertexOffset = params.useSharedGeom ? m_sharedGeom.vertices.size() : 0;
+		// only read the uv sets if texture coordinates are exported
+		int numUVSets = (params.vertexAttributes & VA_TEXCOORD) ? newuvsets.length() : 0;
+		std::vector<float> us(numUVSets), vs(numUVSets);
 		// create an iterator to go through mesh polygons
 		if (mesh.numPolygons() > 0)
 		{
@@ -691,6 +844,8 @@ namespace OgreMayaExporter
 				bool different;
 				int vtxIdx, nrmIdx;
 				faceIter.numTriangles(numTris);
+				MIntArray polyIndices;
+				faceIter.getVertices(polyIndices);
 				// for every triangle composing current polygon extract triangle info
 				for (int iTris=0; iTris<numTris; iTris++)
 				{
@@ -702,8 +857,6 @@ namespace OgreMayaExporter
 					// extract triangle vertex indices
 					faceIter.getTriangle(iTris,triPoints,tempTriVertexIdx);
 					// convert indices to face-relative indices
-					MIntArray polyIndices;
-					faceIter.getVertices(polyIndices);
 					for (uint iObj=0; iObj < tempTriVertexIdx.length(); ++iObj)
 					{
 						// iPoly is face-relative vertex index
@@ -726,16 +879,20 @@ namespace OgreMayaExporter
 							std::cout << "Could not access vertex position\n";
 							std::cout.flush();
 						}
-						nrmIdx = faceIter.normalIndex(triVertexIdx[i],&stat);
-						if (stat != MS::kSuccess)
+						// get vertex normal
+						nrmIdx = -1;
+						if (params.vertexAttributes & VA_NORMAL)
 						{
-							std::cout << "Could not access vertex normal\n";
-							std::cout.flush();
+							nrmIdx = faceIter.normalIndex(triVertexIdx[i],&stat);
+							if (stat != MS::kSuccess)
+							{
+								std::cout << "Could not access vertex normal\n";
+								std::cout.flush();
+							}
 						}
-
 						// get vertex color
-						MColor color;
-						if (faceIter.hasColor(triVertexIdx[i]))
+						MColor color(1,1,1,1);
+						if ((params.vertexAttributes & VA_COLOUR) && faceIter.hasColor(triVertexIdx[i]))
 						{
 							stat = faceIter.getColor(color,triVertexIdx[i]);
 							if (MS::kSuccess != stat)
@@ -759,9 +916,22 @@ namespace OgreMayaExporter
 							else if (color.a < PRECISION)
 								color.a = 0;
 						}
-						else
+						// get vertex texture coordinates
+						for (int j=0; j<numUVSets; j++)
 						{
-							color = MColor(1,1,1,1);
+							float2 uv;
+							stat = faceIter.getUV(triVertexIdx[i],uv,&newuvsets[j]);
+							if (MS::kSuccess != stat)
+							{
+								uv[0] = 0;
+								uv[1] = 0;
+							}
+							if (fabs(uv[0]) < PRECISION)
+								uv[0] = 0;
+							if (fabs(uv[1]) < PRECISION)
+								uv[1] = 0;
+							us[j] = uv[0];
+							vs[j] = (-1)*(uv[1]-1);
 						}
 						if (newvertices[vtxIdx].next == -2)	// first time we encounter a vertex in this position
 						{
@@ -776,8 +946,8 @@ namespace OgreMayaExporter
 							newvertices[vtxIdx].b = color.b;
 							newvertices[vtxIdx].a = color.a;
 							// save vertex texture coordinates
-							newvertices[vtxIdx].u.resize(newuvsets.length());
-							newvertices[vtxIdx].v.resize(newuvsets.length());
+							newvertices[vtxIdx].u = us;
+							newvertices[vtxIdx].v = vs;
 							// save vbas
 							newvertices[vtxIdx].vba.resize(newweights[vtxIdx].length());
 							for (int j=0; j<newweights[vtxIdx].length(); j++)
@@ -790,32 +960,20 @@ namespace OgreMayaExporter
 							{
 								newvertices[vtxIdx].jointIds[j] = (newjointIds[vtxIdx])[j];
 							}
-							// save uv sets data
-							for (int j=0; j<newuvsets.length(); j++)
-							{
-								float2 uv;
-								stat = faceIter.getUV(triVertexIdx[i],uv,&newuvsets[j]);
-								if (MS::kSuccess != stat)
-								{
-									uv[0] = 0;
-									uv[1] = 0;
-								}
-								newvertices[vtxIdx].u[j] = uv[0];
-								newvertices[vtxIdx].v[j] = (-1)*(uv[1]-1);
-							}
 							// save vertex index in face info
-							newFace.v[i] = m_sharedGeom.vertices.size() + vtxIdx;
+							newFace.v[i] = vertexOffset + vtxIdx;
 							// update value of index to next vertex info (-1 means nothing next)
 							newvertices[vtxIdx].next = -1;
 						}
 						else	// already found at least 1 vertex in this position
 						{
-							// check if a vertex with same attributes has been saved already
+							// check if a vertex with same attributes has been saved already,
+							// attributes that are not exported are not compared
 							for (int k=vtxIdx; k!=-1 && different; k=newvertices[k].next)
 							{
 								different = false;
 
-								if (params.exportVertNorm)
+								if (params.vertexAttributes & VA_NORMAL)
 								{
 									MFloatVector n1 = newnormals[newvertices[k].normalIdx];
 									MFloatVector n2 = newnormals[nrmIdx];
@@ -825,28 +983,17 @@ namespace OgreMayaExporter
 									}
 								}
 
-								if ((params.exportVertCol) &&
+								if ((params.vertexAttributes & VA_COLOUR) &&
 									(newvertices[k].r!=color.r || newvertices[k].g!=color.g || newvertices[k].b!= color.b || newvertices[k].a!=color.a))
 								{
 									different = true;
 								}
 
-								if (params.exportTexCoord)
+								for (int j=0; j<numUVSets && !different; j++)
 								{
-									for (int j=0; j<newuvsets.length(); j++)
+									if (newvertices[k].u[j]!=us[j] || newvertices[k].v[j]!=vs[j])
 									{
-										float2 uv;
-										stat = faceIter.getUV(triVertexIdx[i],uv,&newuvsets[j]);
-										if (MS::kSuccess != stat)
-										{
-											uv[0] = 0;
-											uv[1] = 0;
-										}
-										uv[1] = (-1)*(uv[1]-1);
-										if (newvertices[k].u[j]!=uv[0] || newvertices[k].v[j]!=uv[1])
-										{
-											different = true;
-										}
+										different = true;
 									}
 								}
 
@@ -878,33 +1025,17 @@ namespace OgreMayaExporter
 									vtx.jointIds[j] = (newjointIds[vtxIdx])[j];
 								}
 								// save vertex texture coordinates
-								vtx.u.resize(newuvsets.length());
-								vtx.v.resize(newuvsets.length());
-								for (int j=0; j<newuvsets.length(); j++)
-								{
-									float2 uv;
-									stat = faceIter.getUV(triVertexIdx[i],uv,&newuvsets[j]);
-									if (MS::kSuccess != stat)
-									{
-										uv[0] = 0;
-										uv[1] = 0;
-									}
-									if (fabs(uv[0]) < PRECISION)
-										uv[0] = 0;
-									if (fabs(uv[1]) < PRECISION)
-										uv[1] = 0;
-									vtx.u[j] = uv[0];
-									vtx.v[j] = (-1)*(uv[1]-1);
-								}
+								vtx.u = us;
+								vtx.v = vs;
 								vtx.next = -1;
 								newvertices.push_back(vtx);
 								// save vertex index in face info
-								newFace.v[i] = m_sharedGeom.vertices.size() + newvertices.size()-1;
+								newFace.v[i] = vertexOffset + newvertices.size()-1;
 								newvertices[idx].next = newvertices.size()-1;
 							}
 							else
 							{
-								newFace.v[i] = m_sharedGeom.vertices.size() + idx;
+								newFace.v[i] = vertexOffset + idx;
 							}
 						}
 					} // end iteration of triangle vertices
@@ -921,6 +1052,70 @@ namespace OgreMayaExporter
 	}
 
 
+	// Get faces data for exports with no attributes other than positions and bone weights
+	MStatus Mesh::getTriangles(const MDagPath &meshDag, ParamList &params)
+	{
+		MStatus stat;
+		MFnMesh mesh(meshDag);
+		long vertexOffset = params.useSharedGeom ? m_sharedGeom.vertices.size() : 0;
+		// get the triangulation of the whole mesh in a single call
+		MIntArray triangleCounts, triangleVertices;
+		stat = mesh.getTriangles(triangleCounts,triangleVertices);
+		if (MS::kSuccess != stat)
+		{
+			std::cout << "Error accessing mesh triangles\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		std::cout << "num polygons = " << mesh.numPolygons() << "\n";
+		std::cout.flush();
+		int t = 0;
+		for (int iPoly=0; iPoly<triangleCounts.length(); iPoly++)
+		{
+			for (int iTris=0; iTris<triangleCounts[iPoly]; iTris++)
+			{
+				face newFace;
+				for (int i=0; i<3; i++)
+				{
+					int vtxIdx = triangleVertices[3*t+i];
+					if (newvertices[vtxIdx].next == -2)	// first time we encounter this vertex
+					{
+						// save vertex position
+						newpoints[vtxIdx].cartesianize();
+						newvertices[vtxIdx].pointIdx = vtxIdx;
+						newvertices[vtxIdx].normalIdx = -1;
+						newvertices[vtxIdx].r = 1;
+						newvertices[vtxIdx].g = 1;
+						newvertices[vtxIdx].b = 1;
+						newvertices[vtxIdx].a = 1;
+						// save vbas
+						newvertices[vtxIdx].vba.resize(newweights[vtxIdx].length());
+						for (int j=0; j<newweights[vtxIdx].length(); j++)
+						{
+							newvertices[vtxIdx].vba[j] = (newweights[vtxIdx])[j];
+						}
+						// save joint ids
+						newvertices[vtxIdx].jointIds.resize(newjointIds[vtxIdx].length());
+						for (int j=0; j<newjointIds[vtxIdx].length(); j++)
+						{
+							newvertices[vtxIdx].jointIds[j] = (newjointIds[vtxIdx])[j];
+						}
+						newvertices[vtxIdx].next = -1;
+					}
+					newFace.v[i] = vertexOffset + vtxIdx;
+				}
+				t++;
+				// skip faces with no shaders assigned
+				if (shaderPolygonMapping[iPoly] >= 0)
+					polygonSets[shaderPolygonMapping[iPoly]].push_back(newFace);
+			}
+		}
+		std::cout << "done reading mesh triangles\n";
+		std::cout.flush();
+		return MS::kSuccess;
+	}
+
+
 	// Build shared geometry
 	MStatus Mesh::buildSharedGeometry(const MDagPath &meshDag,ParamList& params)
 	{
@@ -949,26 +1144,29 @@ namespace OgreMayaExporter
 			v.y = point.y;
 			v.z = point.z;
 			// save vertex normal
-			MFloatVector normal = newnormals[vInfo.normalIdx];
-			if (fabs(normal.x) < PRECISION)
-				normal.x = 0;
-			if (fabs(normal.y) < PRECISION)
-				normal.y = 0;
-			if (fabs(normal.z) < PRECISION)
-				normal.z = 0;
-			if (opposite)
-			{
-				v.n.x = -normal.x;
-				v.n.y = -normal.y;
-				v.n.z = -normal.z;
-			}
-			else
+			if (vInfo.normalIdx >= 0)
 			{
-				v.n.x = normal.x;
-				v.n.y = normal.y;
-				v.n.z = normal.z;
+				MFloatVector normal = newnormals[vInfo.normalIdx];
+				if (fabs(normal.x) < PRECISION)
+					normal.x = 0;
+				if (fabs(normal.y) < PRECISION)
+					normal.y = 0;
+				if (fabs(normal.z) < PRECISION)
+					normal.z = 0;
+				if (opposite)
+				{
+					v.n.x = -normal.x;
+					v.n.y = -normal.y;
+					v.n.z = -normal.z;
+				}
+				else
+				{
+					v.n.x = normal.x;
+					v.n.y = normal.y;
+					v.n.z = normal.z;
+				}
+				v.n.normalize();
 			}
-			v.n.normalize();
 			// save vertex color
 			v.r = vInfo.r;
 			v.g = vInfo.g;
@@ -1049,6 +1247,9 @@ namespace OgreMayaExporter
 				}
 				//load vertex and face data
 				stat = pSubmesh->load(meshDag,polygonSets[i],newvertices,newpoints,newnormals,newuvsets,params,opposite);
+				//keep the faces indexing the shared geometry too, if the layout is chosen later
+				if (params.autoSharedGeom)
+					pSubmesh->loadSharedFaces(polygonSets[i],m_sharedGeom.dagMap.back().offset,opposite);
 				//if we're not using shared geometry, save a pointer to the blend shape deformer
 				if (pBlendShape && !params.useSharedGeom)
 					pSubmesh->m_pBlendShape = pBlendShape;
@@ -1063,131 +1264,70 @@ namespace OgreMayaExporter
 
 
 /******************** Methods to read vertex animations from Maya ************************/
-	//load a vertex animation clip
-	MStatus Mesh::loadClip(MString& clipName,float start,float stop,float rate,ParamList& params)
+	// Find the animation curves driving the mesh shapes and their transforms, these include
+	// the curves of the deformers and of the joints of the skin cluster
+	void Mesh::findAnimCurves(MObjectArray& curves)
 	{
-		MStatus stat;
-		MString msg;
-		std::vector<float> times;
-		// calculate times from clip sample rate
-		times.clear();
-		for (float t=start; t<stop; t+=rate)
-			times.push_back(t);
-		times.push_back(stop);
-		// get animation length
-		float length=0;
-		if (times.size() >= 0)
-			length = times[times.size()-1] - times[0];		
-		if (length < 0)
-		{
-			std::cout << "invalid time range for the clip, we skip it\n";
-			std::cout.flush();
-			return MS::kFailure;
-		}
-		// create a new animation
-		Animation a;
-		a.m_name = clipName;
-		a.m_length = length;
-		a.m_tracks.clear();
-		// if we're using shared geometry, create a single animation track for the whole mesh
-		if (params.useSharedGeom)
-		{
-			// load the animation track
-			stat = loadMeshTrack(a,times,params);
-			if (stat != MS::kSuccess)
-			{
-				std::cout << "Error loading mesh vertex animation\n";
-				std::cout.flush();
-			}
-		}
-		// else creae a different animation track for each submesh
-		else
+		for (int i=0; i<m_submeshes.size(); i++)
 		{
-			// load all tracks (one for each submesh)
-			stat = loadSubmeshTracks(a,times,params);
-			if (stat != MS::kSuccess)
+			MDagPath path = m_submeshes[i]->m_dagPath;
+			while (path.length() > 0)
 			{
-				std::cout << "Error loading submeshes vertex animation\n";
-				std::cout.flush();
-				return MS::kFailure;
+				TimelineSampler::findAnimCurves(path.node(),curves);
+				path.pop();
 			}
 		}
-		// add newly created animation to animations list
-		m_vertexClips.push_back(a);
-		// display info
-		std::cout << "length: " << a.m_length << "\n";
-		std::cout << "num keyframes: " << a.m_tracks[0].m_vertexKeyframes.size() << "\n";
-		std::cout.flush();
-		// clip successfully loaded
-		return MS::kSuccess;
 	}
 
-
-	//load an animation track for the whole mesh (using shared geometry)
-	MStatus Mesh::loadMeshTrack(Animation& a,std::vector<float> &times, OgreMayaExporter::ParamList &params)
+	// Register vertex animation clips with the timeline sampler
+	MStatus Mesh::registerVertexAnims(TimelineSampler& sampler,ParamList& params)
 	{
-		MStatus stat;
-		// create a new track
-		Track t;
-		t.m_type = TT_MORPH;
-		t.m_target = T_MESH;
-		t.m_vertexKeyframes.clear();
-		// get keyframes at given times
-		for (int i=0; i<times.size(); i++)
-		{
-			//set time to wanted sample time
-			MAnimControl::setCurrentTime(MTime(times[i],MTime::kSeconds));
-			//load a keyframe for the mesh at current time
-			stat = loadKeyframe(t,times[i]-times[0],params);
-			if (stat != MS::kSuccess)
+		std::cout << "Loading vertex animations...\n";
+		std::cout.flush();
+		// clear animations data
+		m_vertexClips.clear();
+		MObjectArray curves;
+		if (TimelineSampler::hasAutoRate(params.vertClipList))
+			findAnimCurves(curves);
+		for (int i=0; i<params.vertClipList.size(); i++)
+		{
+			clipInfo ci = params.vertClipList[i];
+			std::cout << "Loading clip " << ci.name.asChar() << "\n";
+			std::cout.flush();
+			// calculate times from clip sample rate
+			std::vector<float> times;
+			if (TimelineSampler::getClipTimes(ci.start,ci.stop,ci.rate,curves,params.autoRateTolerance,times) != MS::kSuccess)
+				continue;
+			// create a new animation
+			Animation a;
+			a.m_name = ci.name;
+			a.m_length = times[times.size()-1] - times[0];
+			a.m_tracks.clear();
+			// if we're using shared geometry, create a single animation track for the whole mesh
+			if (params.useSharedGeom)
 			{
-				std::cout << "Error reading animation keyframe at time: " << times[i] << "\n";
-				std::cout.flush();
+				Track t;
+				t.m_type = TT_MORPH;
+				t.m_target = T_MESH;
+				t.m_vertexKeyframes.reserve(times.size());
+				a.addTrack(t);
 			}
-		}
-		// add track to given animation
-		a.addTrack(t);
-		// track sucessfully loaded
-		return MS::kSuccess;
-	}
-
-
-	//load all submesh animation tracks (one for each submesh)
-	MStatus Mesh::loadSubmeshTracks(Animation& a,std::vector<float> &times, OgreMayaExporter::ParamList &params)
-	{
-		MStatus stat;
-		// create a new track for each submesh
-		std::vector<Track> tracks;
-		for (int i=0; i<m_submeshes.size(); i++)
-		{
-			Track t;
-			t.m_type = TT_MORPH;
-			t.m_target = T_SUBMESH;
-			t.m_index = i;
-			t.m_vertexKeyframes.clear();
-			tracks.push_back(t);
-		}
-		// get keyframes at given times
-		for (int i=0; i<times.size(); i++)
-		{
-			//set time to wanted sample time
-			MAnimControl::setCurrentTime(MTime(times[i],MTime::kSeconds));
-			//load a keyframe for each submesh at current time
-			for (int j=0; j<m_submeshes.size(); j++)
+			// else create a different animation track for each submesh
+			else
 			{
-				stat = m_submeshes[j]->loadKeyframe(tracks[j],times[i]-times[0],params);
-				if (stat != MS::kSuccess)
+				for (int j=0; j<m_submeshes.size(); j++)
 				{
-					std::cout << "Error reading animation keyframe at time: " << times[i] << " for submesh: " << j << "\n";
-					std::cout.flush();
+					Track t;
+					t.m_type = TT_MORPH;
+					t.m_target = T_SUBMESH;
+					t.m_index = j;
+					t.m_vertexKeyframes.reserve(times.size());
+					a.addTrack(t);
 				}
 			}
+			m_vertexClips.push_back(a);
+			sampler.addClip(this,SC_VERTEX,m_vertexClips.size()-1,times);
 		}
-		// add tracks to given animation
-		for (int i=0; i< tracks.size(); i++)
-			a.addTrack(tracks[i]);
-		// track sucessfully loaded
-		return MS::kSuccess;
 		return MS::kSuccess;
 	}
 
@@ -1233,6 +1373,249 @@ namespace OgreMayaExporter
 		return MS::kSuccess;
 	}
 
+/******************** Prune and reorder bones ************************/
+	// remap the bone assignments of a list of vertices, dropping the ones of removed joints
+	static void remapBoneAssignments(std::vector<vertex>& vertices,const std::vector<int>& remap)
+	{
+		for (int i=0; i<vertices.size(); i++)
+		{
+			std::vector<vba> vbas;
+			for (int j=0; j<vertices[i].vbas.size(); j++)
+			{
+				int jointIdx = remap[vertices[i].vbas[j].jointIdx];
+				if (jointIdx >= 0)
+				{
+					vba newVba = vertices[i].vbas[j];
+					newVba.jointIdx = jointIdx;
+					vbas.push_back(newVba);
+				}
+			}
+			vertices[i].vbas.swap(vbas);
+		}
+	}
+
+	// add the bone weights of a list of vertices to the weight of their joints
+	static void addBoneWeights(const std::vector<vertex>& vertices,std::vector<float>& weights)
+	{
+		for (int i=0; i<vertices.size(); i++)
+		{
+			for (int j=0; j<vertices[i].vbas.size(); j++)
+				weights[vertices[i].vbas[j].jointIdx] += vertices[i].vbas[j].weight;
+		}
+	}
+
+	// Get the total skin weight of every skeleton joint
+	void Mesh::getJointWeights(std::vector<float>& weights)
+	{
+		weights.assign(m_pSkeleton ? m_pSkeleton->getJoints().size() : 0,0);
+		if (!m_pSkeleton)
+			return;
+		addBoneWeights(m_sharedGeom.vertices,weights);
+		for (int i=0; i<m_submeshes.size(); i++)
+			addBoneWeights(m_submeshes[i]->m_vertices,weights);
+	}
+
+	// Remove the skeleton joints that don't deform the mesh and remap the bone assignments
+	MStatus Mesh::pruneBones(ParamList& params)
+	{
+		if (!m_pSkeleton)
+			return MS::kSuccess;
+		// find the joints with weighted vertices
+		std::vector<bool> weighted(m_pSkeleton->getJoints().size(),false);
+		for (int i=0; i<m_sharedGeom.vertices.size(); i++)
+		{
+			for (int j=0; j<m_sharedGeom.vertices[i].vbas.size(); j++)
+			{
+				if (m_sharedGeom.vertices[i].vbas[j].weight > PRECISION)
+					weighted[m_sharedGeom.vertices[i].vbas[j].jointIdx] = true;
+			}
+		}
+		for (int i=0; i<m_submeshes.size(); i++)
+		{
+			std::vector<vertex>& vertices = m_submeshes[i]->m_vertices;
+			for (int j=0; j<vertices.size(); j++)
+			{
+				for (int k=0; k<vertices[j].vbas.size(); k++)
+				{
+					if (vertices[j].vbas[k].weight > PRECISION)
+						weighted[vertices[j].vbas[k].jointIdx] = true;
+				}
+			}
+		}
+		std::vector<int> remap;
+		MStatus stat = m_pSkeleton->pruneJoints(weighted,params,remap);
+		if (MS::kSuccess != stat)
+			return stat;
+		remapBoneAssignments(m_sharedGeom.vertices,remap);
+		for (int i=0; i<m_submeshes.size(); i++)
+			remapBoneAssignments(m_submeshes[i]->m_vertices,remap);
+		return MS::kSuccess;
+	}
+
+	// Order the skeleton joints breadth-first and remap the bone assignments
+	MStatus Mesh::reorderBones(ParamList& params)
+	{
+		if (!m_pSkeleton)
+			return MS::kSuccess;
+		std::vector<int> remap;
+		MStatus stat = m_pSkeleton->reorderJoints(params,remap);
+		if (MS::kSuccess != stat)
+			return stat;
+		remapBoneAssignments(m_sharedGeom.vertices,remap);
+		for (int i=0; i<m_submeshes.size(); i++)
+			remapBoneAssignments(m_submeshes[i]->m_vertices,remap);
+		return MS::kSuccess;
+	}
+
+
+/******************** Choose the geometry layout ************************/
+	// Choose between shared geometry and per-submesh vertex buffers, comparing the estimated
+	// size of the exported data and the number of vertex buffer binds needed to draw the mesh
+	MStatus Mesh::chooseGeometryLayout(ParamList& params)
+	{
+		if (!params.autoSharedGeom || m_submeshes.size() <= 0)
+			return MS::kSuccess;
+		std::cout << "Choosing geometry layout...\n";
+		std::cout.flush();
+		// number of keyframes of the exported vertex animations
+		long numMorphKeys = 0;
+		if (params.exportVertAnims)
+		{
+			MObjectArray curves;
+			if (TimelineSampler::hasAutoRate(params.vertClipList))
+				findAnimCurves(curves);
+			for (int i=0; i<params.vertClipList.size(); i++)
+			{
+				clipInfo ci = params.vertClipList[i];
+				std::vector<float> times;
+				if (TimelineSampler::getClipTimes(ci.start,ci.stop,ci.rate,curves,params.autoRateTolerance,times) == MS::kSuccess)
+					numMorphKeys += times.size();
+			}
+		}
+		// shared geometry: one vertex buffer, every submesh indexes it with 32 bit indices
+		geometryLayoutCost shared;
+		shared.vertexBytes = m_sharedGeom.vertices.size() * getVertexSize(m_sharedGeom.vertices,params);
+		shared.boneAssignmentBytes = getBoneAssignmentsSize(m_sharedGeom.vertices,params);
+		shared.indexBytes = 0;
+		for (int i=0; i<m_submeshes.size(); i++)
+			shared.indexBytes += m_submeshes[i]->m_sharedFaces.size() * 3 * sizeof(Ogre::uint32);
+		shared.poseBytes = 0;
+		for (int i=0; i<m_sharedGeom.dagMap.size(); i++)
+		{
+			dagInfo di = m_sharedGeom.dagMap[i];
+			if (di.pBlendShape && params.exportBlendShapes)
+				shared.poseBytes += di.pBlendShape->countPoseOffsets(di.dagPath,m_sharedGeom.vertices,di.offset,di.numVertices) * POSE_VERTEX_SIZE;
+		}
+		// Ogre morph keyframes hold the position of every vertex of the buffer
+		shared.morphBytes = numMorphKeys * m_sharedGeom.vertices.size() * MORPH_VERTEX_SIZE;
+		shared.binds = 1;
+		shared.total = shared.vertexBytes + shared.boneAssignmentBytes + shared.indexBytes + 
+			shared.poseBytes + shared.morphBytes + shared.binds * params.bindCost;
+		// per-submesh buffers: vertices on material seams are duplicated, small submeshes use 16 bit indices
+		geometryLayoutCost separate;
+		separate.vertexBytes = separate.boneAssignmentBytes = separate.indexBytes = 0;
+		separate.poseBytes = separate.morphBytes = 0;
+		separate.binds = m_submeshes.size();
+		for (int i=0; i<m_submeshes.size(); i++)
+		{
+			Submesh* pSubmesh = m_submeshes[i];
+			separate.vertexBytes += pSubmesh->m_vertices.size() * getVertexSize(pSubmesh->m_vertices,params);
+			separate.boneAssignmentBytes += getBoneAssignmentsSize(pSubmesh->m_vertices,params);
+			separate.indexBytes += pSubmesh->m_faces.size() * 3 * 
+				(pSubmesh->m_use32bitIndexes ? sizeof(Ogre::uint32) : sizeof(Ogre::uint16));
+			if (pSubmesh->m_pBlendShape && params.exportBlendShapes)
+				separate.poseBytes += pSubmesh->m_pBlendShape->countPoseOffsets(pSubmesh->m_dagPath,pSubmesh->m_vertices,0,pSubmesh->m_vertices.size()) * POSE_VERTEX_SIZE;
+			separate.morphBytes += numMorphKeys * pSubmesh->m_vertices.size() * MORPH_VERTEX_SIZE;
+		}
+		separate.total = separate.vertexBytes + separate.boneAssignmentBytes + separate.indexBytes + 
+			separate.poseBytes + separate.morphBytes + separate.binds * params.bindCost;
+		printGeometryLayoutCost("shared geometry",shared);
+		printGeometryLayoutCost("submesh buffers",separate);
+		// report the term that makes the largest difference in favour of the chosen layout
+		bool useShared = shared.total <= separate.total;
+		const geometryLayoutCost& best = useShared ? shared : separate;
+		const geometryLayoutCost& other = useShared ? separate : shared;
+		const char* reasons[] = {"vertex data","bone assignments","index data","pose data","morph data","vertex buffer binds"};
+		double gains[] = {
+			(double)other.vertexBytes - best.vertexBytes,
+			(double)other.boneAssignmentBytes - best.boneAssignmentBytes,
+			(double)other.indexBytes - best.indexBytes,
+			(double)other.poseBytes - best.poseBytes,
+			(double)other.morphBytes - best.morphBytes,
+			((double)other.binds - best.binds) * params.bindCost };
+		int reason = 0;
+		for (int i=1; i<6; i++)
+		{
+			if (gains[i] > gains[reason])
+				reason = i;
+		}
+		std::cout << "Using " << (useShared ? "shared geometry" : "submesh buffers") << ": estimated cost " 
+			<< best.total << " against " << other.total << ", mostly because of less " << reasons[reason] << "\n";
+		std::cout.flush();
+		// discard the layout we are not going to use
+		params.useSharedGeom = useShared;
+		if (useShared)
+		{
+			for (int i=0; i<m_submeshes.size(); i++)
+			{
+				Submesh* pSubmesh = m_submeshes[i];
+				pSubmesh->m_faces.swap(pSubmesh->m_sharedFaces);
+				pSubmesh->m_sharedFaces.clear();
+				pSubmesh->m_vertices.clear();
+				pSubmesh->m_indices.clear();
+				pSubmesh->m_use32bitIndexes = true;
+				// blend shapes are owned by the shared geometry
+				pSubmesh->m_pBlendShape = NULL;
+			}
+		}
+		else
+		{
+			for (int i=0; i<m_submeshes.size(); i++)
+				m_submeshes[i]->m_sharedFaces.clear();
+			// blend shapes are referenced by the submeshes now, so they must not be deleted with the shared geometry
+			for (int i=0; i<m_sharedGeom.dagMap.size(); i++)
+				m_sharedGeom.dagMap[i].pBlendShape = NULL;
+			m_sharedGeom.vertices.clear();
+			m_sharedGeom.dagMap.clear();
+		}
+		return MS::kSuccess;
+	}
+
+	// Get the estimated size in bytes of a vertex in an Ogre vertex buffer
+	size_t Mesh::getVertexSize(const std::vector<vertex>& vertices,ParamList& params)
+	{
+		size_t size = Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+		if (params.exportVertNorm)
+			size += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+		if (params.exportVertCol)
+			size += Ogre::VertexElement::getTypeSize(Ogre::VET_COLOUR);
+		if (vertices.size() > 0)
+			size += vertices[0].texcoords.size() * Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
+		if (params.buildTangents)
+			size += Ogre::VertexElement::getTypeSize(params.tangentsUseParity ? Ogre::VET_FLOAT4 : Ogre::VET_FLOAT3);
+		return size;
+	}
+
+	// Get the estimated size in bytes of the bone assignments of a vertex list
+	size_t Mesh::getBoneAssignmentsSize(const std::vector<vertex>& vertices,ParamList& params)
+	{
+		if (!params.exportVBA)
+			return 0;
+		size_t numAssignments = 0;
+		for (int i=0; i<vertices.size(); i++)
+			numAssignments += vertices[i].vbas.size();
+		return numAssignments * BONE_ASSIGNMENT_SIZE;
+	}
+
+	// Print the estimated cost of a geometry layout
+	void Mesh::printGeometryLayoutCost(const char* name,const geometryLayoutCost& cost)
+	{
+		std::cout << name << ": vertices " << cost.vertexBytes << " bytes, bone assignments " << cost.boneAssignmentBytes 
+			<< " bytes, indices " << cost.indexBytes << " bytes, poses " << cost.poseBytes << " bytes, morphs " 
+			<< cost.morphBytes << " bytes, " << cost.binds << " vertex buffer binds\n";
+		std::cout.flush();
+	}
+
 /*********************************** Export mesh data **************************************/
 	// Write to a OGRE binary mesh
 	MStatus Mesh::writeOgreBinary(ParamList &params)
@@ -1245,6 +1628,12 @@ namespace OgreMayaExporter
 			std::cout.flush();
 			return MS::kFailure;
 		}
+		// Drop vertex attributes not used by the materials
+		m_exportSharedColours = params.exportVertCol;
+		if (params.optimizeAttributes)
+		{
+			analyseAttributeUsage(params);
+		}
 		// Construct mesh
 		Ogre::MeshPtr pMesh = Ogre::MeshManager::getSingleton().createManual(m_name.asChar(), 
 			Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
@@ -1253,17 +1642,34 @@ namespace OgreMayaExporter
 		{
 			createOgreSharedGeometry(pMesh,params);
 		}
-		// Write submeshes data
+		// Create submeshes, registering them with the Ogre mesh is not thread safe
 		for (int i=0; i<m_submeshes.size(); i++)
 		{
 			m_submeshes[i]->createOgreSubmesh(pMesh,params);
 		}
+		// Fill submeshes buffers on the worker pool
+		{
+			WorkerPool workers(params.numThreads);
+			workers.parallelFor(m_submeshes.size(),[this,&params](size_t i)
+			{
+				m_submeshes[i]->fillOgreSubmesh(params);
+			});
+		}
+		// Add submeshes bone assignments
+		for (int i=0; i<m_submeshes.size(); i++)
+		{
+			m_submeshes[i]->addOgreBoneAssignments(params);
+		}
 		// Set skeleton link (if present)
 		if (m_pSkeleton && params.exportSkeleton)
 		{
-			int ri = params.skeletonFilename.rindex('\\');
-			int end = params.skeletonFilename.length() - 1;
-			MString filename = params.skeletonFilename.substring(ri+1,end);
+			// link to the shared skeleton when using a skeleton library
+			MString skeletonFilename = params.skeletonFilename;
+			if (params.skeletonLibraryDir != "")
+				skeletonFilename = m_pSkeleton->getLibraryFilename(params);
+			int ri = std::max(skeletonFilename.rindex('\\'),skeletonFilename.rindex('/'));
+			int end = skeletonFilename.length() - 1;
+			MString filename = skeletonFilename.substring(ri+1,end);
 			pMesh->setSkeletonName(filename.asChar());
 		}
 		// Write poses
@@ -1300,8 +1706,21 @@ namespace OgreMayaExporter
 		{
 			pMesh->buildEdgeList();
 		}
+		// Build tangents only for the submeshes that need them
+		bool buildMeshTangents = params.buildTangents;
+		if (params.buildTangents && params.optimizeAttributes)
+		{
+			buildMeshTangents = false;
+			for (int i=0; i<m_submeshes.size(); i++)
+			{
+				if (m_submeshes[i]->m_buildTangents && params.useSharedGeom)
+					buildMeshTangents = true;
+				else if (m_submeshes[i]->m_buildTangents)
+					buildOgreSubmeshTangents(pMesh,i,params);
+			}
+		}
 		// Build tangents
-		if (params.buildTangents)
+		if (buildMeshTangents)
 		{
 			Ogre::VertexElementSemantic targetSemantic = params.tangentSemantic == TS_TANGENT ? 
 				Ogre::VES_TANGENT : Ogre::VES_TEXTURE_COORDINATES;
@@ -1365,10 +1784,382 @@ namespace OgreMayaExporter
 				}
 			}
 		}
+		// Write the compact pose file, from the poses as completed by the tangent vertex splits
+		if (params.exportBlendShapes && params.exportPoseFile)
+		{
+			stat = writePoseFile(pMesh,params);
+			if (stat != MS::kSuccess)
+			{
+				std::cout << "Error writing pose file\n";
+				std::cout.flush();
+			}
+		}
 		// Export the binary mesh
 		Ogre::MeshSerializer serializer;
 		serializer.exportMesh(pMesh.getPointer(), params.meshFilename.asChar(), params.targetMeshVersion);
 		pMesh.setNull();
+		// Write the bounding volumes of the bones
+		if (params.exportBoneBounds && m_pSkeleton)
+		{
+			stat = writeBoneBounds(params);
+			if (stat != MS::kSuccess)
+			{
+				std::cout << "Error writing bone bounds file\n";
+				std::cout.flush();
+			}
+		}
+		else if (params.exportBoneBounds)
+		{
+			std::cout << "Error writing bone bounds file: the mesh has no skin cluster\n";
+			std::cout.flush();
+		}
+		return MS::kSuccess;
+	}
+
+	// add the positions of the vertices weighted to each bone, in the bind space of the bone
+	static void addBoneVertices(const std::vector<vertex>& vertices,float threshold,const std::vector<Ogre::Vector3>& position,
+		const std::vector<Ogre::Quaternion>& invOrientation,const std::vector<Ogre::Vector3>& scale,
+		std::vector<std::vector<Ogre::Vector3> >& boneVertices)
+	{
+		for (int i=0; i<vertices.size(); i++)
+		{
+			Ogre::Vector3 v(vertices[i].x,vertices[i].y,vertices[i].z);
+			for (int k=0; k<vertices[i].vbas.size(); k++)
+			{
+				int j = vertices[i].vbas[k].jointIdx;
+				if (vertices[i].vbas[k].weight >= threshold)
+					boneVertices[j].push_back((invOrientation[j] * (v - position[j])) / scale[j]);
+			}
+		}
+	}
+
+	// Write the bounding box and capsule of the vertices influenced by each bone, in the bind space
+	// of the bone, so the runtime can transform them by the bone transforms instead of skinning vertices
+	MStatus Mesh::writeBoneBounds(ParamList& params)
+	{
+		std::vector<joint>& joints = m_pSkeleton->getJoints();
+		std::vector<Ogre::Vector3> position, scale;
+		std::vector<Ogre::Quaternion> orientation;
+		m_pSkeleton->getBindTransforms(position,orientation,scale,true);
+		for (int j=0; j<orientation.size(); j++)
+			orientation[j] = orientation[j].Inverse();
+		std::vector<std::vector<Ogre::Vector3> > boneVertices(joints.size());
+		addBoneVertices(m_sharedGeom.vertices,params.boneBoundsWeight,position,orientation,scale,boneVertices);
+		for (int i=0; i<m_submeshes.size(); i++)
+			addBoneVertices(m_submeshes[i]->m_vertices,params.boneBoundsWeight,position,orientation,scale,boneVertices);
+		bool anyBounded = false;
+		for (int j=0; j<boneVertices.size() && !anyBounded; j++)
+			anyBounded = !boneVertices[j].empty();
+		if (!anyBounded)
+		{
+			std::cout << "Error: no vertex has a weight of at least " << params.boneBoundsWeight << " to any bone\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		MString filename = params.meshFilename + ".bonebounds";
+		std::ofstream out(filename.asChar());
+		if (!out)
+		{
+			std::cout << "Error opening file: " << filename.asChar() << "\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		out << "# bone bounding volumes in bone bind space, for vertices with a weight of at least " << params.boneBoundsWeight << "\n";
+		out << "# handle name box minX minY minZ maxX maxY maxZ capsule aX aY aZ bX bY bZ radius\n";
+		int numBounded = 0;
+		for (int j=0; j<joints.size(); j++)
+		{
+			std::vector<Ogre::Vector3>& points = boneVertices[j];
+			if (points.empty())
+				continue;
+			// box
+			Ogre::Vector3 min = points[0], max = points[0];
+			for (int i=1; i<points.size(); i++)
+			{
+				min.makeFloor(points[i]);
+				max.makeCeil(points[i]);
+			}
+			// capsule along the longest axis of the box, through its centre
+			Ogre::Vector3 extent = max - min;
+			int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+			int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			Ogre::Vector3 centre = (min + max) * 0.5f;
+			float radius = 0;
+			for (int i=0; i<points.size(); i++)
+			{
+				Ogre::Vector3 d = points[i] - centre;
+				radius = std::max(radius,Ogre::Math::Sqrt(d[u]*d[u] + d[v]*d[v]));
+			}
+			// the segment ends as close to each other as the spherical caps allow
+			float a = max[axis], b = min[axis];
+			for (int i=0; i<points.size(); i++)
+			{
+				Ogre::Vector3 d = points[i] - centre;
+				float s = Ogre::Math::Sqrt(std::max(0.0f,radius*radius - d[u]*d[u] - d[v]*d[v]));
+				a = std::min(a,points[i][axis] + s);
+				b = std::max(b,points[i][axis] - s);
+			}
+			if (a > b)
+				a = b = (a + b) * 0.5f;
+			Ogre::Vector3 capA = centre, capB = centre;
+			capA[axis] = a;
+			capB[axis] = b;
+			out << joints[j].id << " " << joints[j].name.asChar()
+				<< " box " << min.x << " " << min.y << " " << min.z << " " << max.x << " " << max.y << " " << max.z
+				<< " capsule " << capA.x << " " << capA.y << " " << capA.z << " " << capB.x << " " << capB.y << " " << capB.z
+				<< " " << radius << "\n";
+			numBounded++;
+		}
+		out.close();
+		std::cout << "Wrote bounding volumes of " << numBounded << " bones to " << filename.asChar() << "\n";
+		std::cout.flush();
+		return MS::kSuccess;
+	}
+
+	// Analyse which vertex attributes are referenced by the materials and drop the unused ones
+	MStatus Mesh::analyseAttributeUsage(ParamList& params)
+	{
+		std::cout << "Analysing vertex attributes usage...\n";
+		std::cout.flush();
+		size_t uvSize = Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
+		size_t colourSize = Ogre::VertexElement::getTypeSize(Ogre::VET_COLOUR);
+		size_t tangentSize = Ogre::VertexElement::getTypeSize(params.tangentsUseParity ? Ogre::VET_FLOAT4 : Ogre::VET_FLOAT3);
+		// Collect the uv sets referenced by the textures of each material. Tangents are built
+		// from the normal map uv set, or from the first set when the material has no normal map
+		std::map<Material*,std::vector<bool> > materialUVSets;
+		for (int i=0; i<m_submeshes.size(); i++)
+		{
+			Submesh* pSubmesh = m_submeshes[i];
+			Material* pMaterial = pSubmesh->m_pMaterial;
+			pSubmesh->m_buildTangents = params.buildTangents && pMaterial->needsTangents();
+			std::vector<bool>& usedSets = materialUVSets[pMaterial];
+			std::vector<int> setIndices;
+			for (int j=0; j<pMaterial->m_textures.size(); j++)
+				setIndices.push_back(pMaterial->m_textures[j].uvsetIndex);
+			if (pSubmesh->m_buildTangents)
+				setIndices.push_back(pMaterial->m_hasNormalMap ? pMaterial->m_normalMap.uvsetIndex : 0);
+			for (int j=0; j<setIndices.size(); j++)
+			{
+				if (setIndices[j] < 0)
+					continue;
+				if (setIndices[j] >= usedSets.size())
+					usedSets.resize(setIndices[j]+1,false);
+				usedSets[setIndices[j]] = true;
+			}
+		}
+		// Shared geometry has a single vertex layout, so it keeps the union of all used sets
+		std::vector<bool> sharedUsedSets;
+		if (params.useSharedGeom)
+		{
+			std::map<Material*,std::vector<bool> >::iterator it;
+			for (it = materialUVSets.begin(); it != materialUVSets.end(); it++)
+			{
+				if (it->second.size() > sharedUsedSets.size())
+					sharedUsedSets.resize(it->second.size(),false);
+				for (int j=0; j<it->second.size(); j++)
+				{
+					if (it->second[j])
+						sharedUsedSets[j] = true;
+				}
+			}
+			for (it = materialUVSets.begin(); it != materialUVSets.end(); it++)
+				it->second = sharedUsedSets;
+		}
+		// Remap the uv set indices referenced by the materials to the compacted sets
+		std::map<Material*,std::vector<bool> >::iterator it;
+		for (it = materialUVSets.begin(); it != materialUVSets.end(); it++)
+		{
+			Material* pMaterial = it->first;
+			std::vector<int> remap(it->second.size(),0);
+			int newIndex = 0;
+			for (int j=0; j<it->second.size(); j++)
+			{
+				if (it->second[j])
+					remap[j] = newIndex++;
+			}
+			for (int j=0; j<pMaterial->m_textures.size(); j++)
+			{
+				if (pMaterial->m_textures[j].uvsetIndex >= 0)
+					pMaterial->m_textures[j].uvsetIndex = remap[pMaterial->m_textures[j].uvsetIndex];
+			}
+			if (pMaterial->m_hasNormalMap && pMaterial->m_normalMap.uvsetIndex >= 0 &&
+				pMaterial->m_normalMap.uvsetIndex < remap.size())
+				pMaterial->m_normalMap.uvsetIndex = remap[pMaterial->m_normalMap.uvsetIndex];
+		}
+		// Drop the unused attributes
+		if (params.useSharedGeom)
+		{
+			long numVertices = m_sharedGeom.vertices.size();
+			int droppedSets = numVertices > 0 ? m_sharedGeom.vertices[0].texcoords.size() : 0;
+			compactTexCoords(m_sharedGeom.vertices,sharedUsedSets);
+			if (numVertices > 0)
+				droppedSets -= m_sharedGeom.vertices[0].texcoords.size();
+			bool dropColours = params.exportVertCol && hasConstantWhiteColour(m_sharedGeom.vertices);
+			if (dropColours)
+				m_exportSharedColours = false;
+			bool buildTangents = false;
+			for (int i=0; i<m_submeshes.size(); i++)
+			{
+				if (m_submeshes[i]->m_buildTangents)
+					buildTangents = true;
+			}
+			bool dropTangents = params.buildTangents && !buildTangents;
+			size_t saved = numVertices * (droppedSets*uvSize + (dropColours ? colourSize : 0) + (dropTangents ? tangentSize : 0));
+			std::cout << "Shared geometry: dropped " << droppedSets << " uv sets" << (dropColours ? ", constant colours" : "")
+				<< (dropTangents ? ", tangents" : "") << " (" << saved << " bytes saved)\n";
+			std::cout.flush();
+		}
+		else
+		{
+			for (int i=0; i<m_submeshes.size(); i++)
+			{
+				Submesh* pSubmesh = m_submeshes[i];
+				long numVertices = pSubmesh->m_vertices.size();
+				int droppedSets = numVertices > 0 ? pSubmesh->m_vertices[0].texcoords.size() : 0;
+				compactTexCoords(pSubmesh->m_vertices,materialUVSets[pSubmesh->m_pMaterial]);
+				if (numVertices > 0)
+					droppedSets -= pSubmesh->m_vertices[0].texcoords.size();
+				bool dropColours = params.exportVertCol && hasConstantWhiteColour(pSubmesh->m_vertices);
+				if (dropColours)
+					pSubmesh->m_exportColours = false;
+				bool dropTangents = params.buildTangents && !pSubmesh->m_buildTangents;
+				size_t saved = numVertices * (droppedSets*uvSize + (dropColours ? colourSize : 0) + (dropTangents ? tangentSize : 0));
+				std::cout << "Submesh " << pSubmesh->m_name.asChar() << ": dropped " << droppedSets << " uv sets" 
+					<< (dropColours ? ", constant colours" : "") << (dropTangents ? ", tangents" : "") 
+					<< " (" << saved << " bytes saved)\n";
+				std::cout.flush();
+			}
+		}
+		return MS::kSuccess;
+	}
+
+	// Keep only the used texture coordinate sets of a vertex list
+	void Mesh::compactTexCoords(std::vector<vertex>& vertices,const std::vector<bool>& usedSets)
+	{
+		texcoord zero;
+		zero.u = zero.v = zero.w = 0;
+		for (int i=0; i<vertices.size(); i++)
+		{
+			std::vector<texcoord> texcoords;
+			for (int j=0; j<usedSets.size(); j++)
+			{
+				if (!usedSets[j])
+					continue;
+				if (j < vertices[i].texcoords.size())
+					texcoords.push_back(vertices[i].texcoords[j]);
+				else
+					texcoords.push_back(zero);
+			}
+			vertices[i].texcoords.swap(texcoords);
+		}
+	}
+
+	// Check if all vertices in a list have a white opaque colour
+	bool Mesh::hasConstantWhiteColour(const std::vector<vertex>& vertices)
+	{
+		for (int i=0; i<vertices.size(); i++)
+		{
+			const vertex& v = vertices[i];
+			if (fabs(v.r-1) > PRECISION || fabs(v.g-1) > PRECISION || fabs(v.b-1) > PRECISION || fabs(v.a-1) > PRECISION)
+				return false;
+		}
+		return true;
+	}
+
+	// Build tangents for a single submesh with its own vertex data
+	MStatus Mesh::buildOgreSubmeshTangents(Ogre::MeshPtr pMesh,int index,ParamList& params)
+	{
+		Submesh* pSubmesh = m_submeshes[index];
+		Ogre::SubMesh* pOgreSubmesh = pSubmesh->m_pOgreSubmesh;
+		Ogre::VertexData* pVertexData = pOgreSubmesh->vertexData;
+		if (pSubmesh->m_vertices.empty())
+			return MS::kFailure;
+		Ogre::VertexElementSemantic targetSemantic = params.tangentSemantic == TS_TANGENT ? 
+			Ogre::VES_TANGENT : Ogre::VES_TEXTURE_COORDINATES;
+		// Source uv set is the normal map one, tangents stored as texture coordinates use the first free set
+		Material* pMaterial = pSubmesh->m_pMaterial;
+		unsigned short srcTex = pMaterial->m_hasNormalMap && pMaterial->m_normalMap.uvsetIndex >= 0 ? 
+			pMaterial->m_normalMap.uvsetIndex : 0;
+		unsigned short destTex = 0;
+		if (targetSemantic == Ogre::VES_TEXTURE_COORDINATES)
+			destTex = pSubmesh->m_vertices[0].texcoords.size();
+		const Ogre::VertexElement* tc_elem = pVertexData->vertexDeclaration->findElementBySemantic(
+			Ogre::VES_TEXTURE_COORDINATES, srcTex);
+		if (!tc_elem)
+		{
+			std::cout << "Warning: submesh " << pSubmesh->m_name.asChar() << " has no texture coordinates, can't build tangents\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		// Scale UVs to prevent zero tangents
+		std::vector< std::pair<float, float> > uvs;
+		Ogre::HardwareVertexBufferSharedPtr vbuf = pVertexData->vertexBufferBinding->getBuffer(tc_elem->getSource());
+		if (params.preventZeroTangent)
+		{
+			unsigned char* pVertex = static_cast<unsigned char*>(vbuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
+			float* pFloat;
+			for (size_t j=0; j<pVertexData->vertexCount; j++, pVertex += vbuf->getVertexSize())
+			{
+				tc_elem->baseVertexPointerToElement(pVertex, &pFloat);
+				uvs.push_back(std::pair<float,float>(pFloat[0],pFloat[1]));
+				pFloat[0] *= params.uvScale;
+				pFloat[1] *= params.uvScale;
+			}
+			vbuf->unlock();
+		}
+		// Build tangents
+		Ogre::TangentSpaceCalc tangentsCalc;
+		tangentsCalc.setSplitMirrored(params.tangentsSplitMirrored);
+		tangentsCalc.setSplitRotated(params.tangentsSplitRotated);
+		tangentsCalc.setStoreParityInW(params.tangentsUseParity);
+		tangentsCalc.setVertexData(pVertexData);
+		tangentsCalc.addIndexData(pOgreSubmesh->indexData, pOgreSubmesh->operationType);
+		Ogre::TangentSpaceCalc::Result res = tangentsCalc.build(targetSemantic, srcTex, destTex);
+		// Split vertices need a copy of the bone assignments and pose offsets of their original
+		for (int i=0; i<res.vertexSplits.size(); i++)
+		{
+			size_t srcIdx = res.vertexSplits[i].first;
+			size_t newIdx = res.vertexSplits[i].second;
+			const Ogre::SubMesh::VertexBoneAssignmentList& vbas = pOgreSubmesh->getBoneAssignments();
+			std::vector<Ogre::VertexBoneAssignment> newVbas;
+			Ogre::SubMesh::VertexBoneAssignmentList::const_iterator bi;
+			for (bi = vbas.lower_bound(srcIdx); bi != vbas.upper_bound(srcIdx); bi++)
+			{
+				newVbas.push_back(bi->second);
+				newVbas.back().vertexIndex = newIdx;
+			}
+			for (int j=0; j<newVbas.size(); j++)
+				pOgreSubmesh->addBoneAssignment(newVbas[j]);
+			for (int j=0; j<pMesh->getPoseCount(); j++)
+			{
+				Ogre::Pose* pPose = pMesh->getPose(j);
+				if (pPose->getTarget() != index+1)
+					continue;
+				const Ogre::Pose::VertexOffsetMap& offsets = pPose->getVertexOffsets();
+				Ogre::Pose::VertexOffsetMap::const_iterator oi = offsets.find(srcIdx);
+				if (oi != offsets.end())
+					pPose->addVertex(newIdx, oi->second);
+			}
+		}
+		// Reset scaled UVs, the buffer may have been recreated with split vertices appended
+		if (params.preventZeroTangent)
+		{
+			tc_elem = pVertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_TEXTURE_COORDINATES, srcTex);
+			vbuf = pVertexData->vertexBufferBinding->getBuffer(tc_elem->getSource());
+			unsigned char* pVertex = static_cast<unsigned char*>(vbuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
+			float* pFloat;
+			for (size_t j=0; j<pVertexData->vertexCount; j++, pVertex += vbuf->getVertexSize())
+			{
+				tc_elem->baseVertexPointerToElement(pVertex, &pFloat);
+				// split vertices are appended in the same order as the splits list
+				size_t uvIdx = j;
+				while (uvIdx >= uvs.size())
+					uvIdx = res.vertexSplits[uvIdx - uvs.size()].first;
+				pFloat[0] = uvs[uvIdx].first;
+				pFloat[1] = uvs[uvIdx].second;
+			}
+			vbuf->unlock();
+		}
 		return MS::kSuccess;
 	}
 
@@ -1393,7 +2184,7 @@ namespace OgreMayaExporter
 			offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
 		}
 		// Add vertex colour
-		if (params.exportVertCol)
+		if (m_exportSharedColours)
 		{
 			pDecl->addElement(buf, offset, Ogre::VET_COLOUR, Ogre::VES_DIFFUSE);
             offset += Ogre::VertexElement::getTypeSize(Ogre::VET_COLOUR);
@@ -1409,35 +2200,17 @@ namespace OgreMayaExporter
 		Ogre::VertexDeclaration* pOptimalDecl = pDecl->getAutoOrganisedDeclaration(params.exportVBA,params.exportBlendShapes || params.exportVertAnims, false); // TODO figure out the error
 		// Create the vertex buffer using the newly created vertex declaration
 		stat = createOgreVertexBuffer(pMesh,pDecl,m_sharedGeom.vertices);
-		// Write vertex bone assignements list
+		// Write vertex bone assignements list, rationalised in a single pass over the vertices.
+		// Blend index and weight buffers can't be built here: the .mesh format only stores the
+		// assignment list, from which Ogre rebuilds the buffers when the mesh is loaded
 		if (params.exportVBA)
 		{
-			// Create a new vertex bone assignements list
-			Ogre::Mesh::VertexBoneAssignmentList vbas;
-			// Scan list of shared geometry vertices
+			std::vector<Ogre::VertexBoneAssignment> vbas;
+			vbas.reserve(m_sharedGeom.vertices.size() * OGRE_MAX_BLEND_WEIGHTS);
 			for (int i=0; i<m_sharedGeom.vertices.size(); i++)
-			{
-				vertex v = m_sharedGeom.vertices[i];
-				// Add all bone assignements for every vertex to the bone assignements list
-				for (int j=0; j<v.vbas.size(); j++)
-				{
-					Ogre::VertexBoneAssignment vba;
-					vba.vertexIndex = i;
-					vba.boneIndex = v.vbas[j].jointIdx;
-					vba.weight = v.vbas[j].weight;
-					if (vba.weight > 0.0f)
-						vbas.insert(Ogre::Mesh::VertexBoneAssignmentList::value_type(i, vba));
-				}
-			}
-			// Rationalise the bone assignements list
-			pMesh->_rationaliseBoneAssignments(pMesh->sharedVertexData->vertexCount,vbas);
-			// Add bone assignements to the mesh
-			for (Ogre::Mesh::VertexBoneAssignmentList::iterator bi = vbas.begin(); bi != vbas.end(); bi++)
-			{
-				pMesh->addBoneAssignment(bi->second);
-			}
-			pMesh->_compileBoneAssignments();
-			pMesh->_updateCompiledBoneAssignments();
+				Submesh::rationaliseBoneAssignments(m_sharedGeom.vertices[i],i,vbas);
+			for (int i=0; i<vbas.size(); i++)
+				pMesh->addBoneAssignment(vbas[i]);
 		}
 		// Reorganize vertex buffers
 		pMesh->sharedVertexData->reorganiseBuffers(pOptimalDecl);
@@ -1507,10 +2280,51 @@ namespace OgreMayaExporter
 		vbuf->unlock();
 		return MS::kSuccess;
 	}
+	// hash of the target and moved vertices of a pose, the offsets are compared within a tolerance
+	// so they are left out. Poses only match when they move the same vertices, mirrored poses never do
+	static uint64_t hashPose(const pose& p)
+	{
+		uint64_t hash = HASH_SEED;
+		int32_t target = p.index;
+		hashBytes(hash,&target,sizeof(target));
+		for (int i=0; i<p.offsets.size(); i++)
+		{
+			int32_t index = p.offsets[i].index;
+			hashBytes(hash,&index,sizeof(index));
+		}
+		return hash;
+	}
+
+	// find an exported pose with the same target and vertices, and offsets differing by at most
+	// the given tolerance, returns -1 if there is none
+	static int findDuplicatePose(const pose& p,uint64_t hash,float tolerance,const std::vector<pose*>& poses,const std::multimap<uint64_t,int>& poseHashes)
+	{
+		std::multimap<uint64_t,int>::const_iterator it = poseHashes.lower_bound(hash);
+		for (; it != poseHashes.end() && it->first == hash; it++)
+		{
+			const pose& other = *poses[it->second];
+			if (other.index != p.index || other.offsets.size() != p.offsets.size())
+				continue;
+			bool same = true;
+			for (int i=0; i<p.offsets.size() && same; i++)
+			{
+				const vertexOffset& a = p.offsets[i];
+				const vertexOffset& b = other.offsets[i];
+				same = (a.index == b.index && fabs(a.x - b.x) <= tolerance && fabs(a.y - b.y) <= tolerance && fabs(a.z - b.z) <= tolerance);
+			}
+			if (same)
+				return it->second;
+		}
+		return -1;
+	}
+
 	// Create mesh poses for an Ogre mesh
 	MStatus Mesh::createOgrePoses(Ogre::MeshPtr pMesh,ParamList& params)
 	{
 		int poseCounter = 0;
+		// exported poses, and their hashes to find identical poses
+		std::vector<pose*> uniquePoses;
+		std::multimap<uint64_t,int> poseHashes;
 		if (params.useSharedGeom)
 		{
 			// Create an entry in the submesh pose remapping table for the shared geometry
@@ -1535,6 +2349,17 @@ namespace OgreMayaExporter
 							p->name = "pose";
 							p->name += poseCounter;
 						}
+						// Reuse an identical pose exported before
+						uint64_t hash = params.poseDedupe ? hashPose(*p) : 0;
+						int duplicate = params.poseDedupe ? findDuplicatePose(*p,hash,params.poseDedupeTolerance,uniquePoses,poseHashes) : -1;
+						if (duplicate >= 0)
+						{
+							std::cout << "pose " << p->name.asChar() << " matches pose " << uniquePoses[duplicate]->name.asChar() << ", skipped\n";
+							std::cout.flush();
+							sbr.insert(std::pair<int,int>(poseCounter,duplicate));
+							poseCounter++;
+							continue;
+						}
 						// Create a new pose for the ogre mesh
 						Ogre::Pose* pPose = pMesh->createPose(0,p->name.asChar());
 						// Set the pose attributes
@@ -1544,7 +2369,10 @@ namespace OgreMayaExporter
 							pPose->addVertex(p->offsets[k].index,offset);
 						}
 						// Add a pose remapping for current pose
-						sbr.insert(std::pair<int,int>(poseCounter,poseCounter));
+						sbr.insert(std::pair<int,int>(poseCounter,uniquePoses.size()));
+						if (params.poseDedupe)
+							poseHashes.insert(std::pair<uint64_t,int>(hash,uniquePoses.size()));
+						uniquePoses.push_back(p);
 						poseCounter++;
 					}
 				}
@@ -1575,6 +2403,17 @@ namespace OgreMayaExporter
 							p->name = "pose";
 							p->name += poseCounter;
 						}
+						// Reuse an identical pose exported before
+						uint64_t hash = params.poseDedupe ? hashPose(*p) : 0;
+						int duplicate = params.poseDedupe ? findDuplicatePose(*p,hash,params.poseDedupeTolerance,uniquePoses,poseHashes) : -1;
+						if (duplicate >= 0)
+						{
+							std::cout << "pose " << p->name.asChar() << " matches pose " << uniquePoses[duplicate]->name.asChar() << ", skipped\n";
+							std::cout.flush();
+							sbr.insert(std::pair<int,int>(j,duplicate));
+							poseCounter++;
+							continue;
+						}
 						// Create a new pose for the ogre mesh
 						Ogre::Pose* pPose = pMesh->createPose(p->index,p->name.asChar());
 						// Set the pose attributes
@@ -1584,13 +2423,113 @@ namespace OgreMayaExporter
 							pPose->addVertex(p->offsets[k].index,offset);
 						}
 						// Add a pose remapping for current pose
-						sbr.insert(std::pair<int,int>(j,poseCounter));
-						
+						sbr.insert(std::pair<int,int>(j,uniquePoses.size()));
+						if (params.poseDedupe)
+							poseHashes.insert(std::pair<uint64_t,int>(hash,uniquePoses.size()));
+						uniquePoses.push_back(p);
 						poseCounter++;
 					}
 				}
 			}
 		}
+		if (params.poseDedupe)
+		{
+			std::cout << "Exported " << uniquePoses.size() << " unique poses of " << poseCounter << "\n";
+			std::cout.flush();
+		}
+		return MS::kSuccess;
+	}
+
+	// Write the poses of the Ogre mesh to a compact file, with the vertex indices stored as runs
+	// of consecutive vertices and the offsets optionally quantised to 16 bits.
+	// File layout, all values little endian:
+	//  header:		char[4] "POSE", uint32 version, uint32 number of poses, uint32 1 if quantised else 0
+	//  pose:		uint16 target (0 for shared geometry, else submesh index + 1), uint16 name length, name,
+	//				uint32 number of runs, uint32 first vertex and uint32 number of vertices per run, offsets
+	//  offsets:	quantised -> float min[3], float extent[3], uint16[3] per vertex, else float[3] per vertex
+	// Poses are stored in the order of the Ogre mesh poses, so pose animations index them the same way.
+	MStatus Mesh::writePoseFile(Ogre::MeshPtr pMesh,ParamList& params)
+	{
+		MString filename = params.meshFilename + ".poses";
+		std::vector<unsigned char> data;
+		data.insert(data.end(),"POSE","POSE" + 4);
+		putU32(data,1);
+		putU32(data,pMesh->getPoseCount());
+		putU32(data,params.poseQuant ? 1 : 0);
+		size_t floatSize = 0;
+		float maxError = 0;
+		for (int i=0; i<pMesh->getPoseCount(); i++)
+		{
+			Ogre::Pose* pPose = pMesh->getPose(i);
+			const Ogre::Pose::VertexOffsetMap& offsets = pPose->getVertexOffsets();
+			const Ogre::String& name = pPose->getName();
+			putU16(data,pPose->getTarget());
+			putU16(data,name.length());
+			data.insert(data.end(),name.begin(),name.end());
+			// runs of consecutive vertex indices, the offsets are sorted by vertex index
+			std::vector<uint32_t> runs;
+			Ogre::Pose::VertexOffsetMap::const_iterator it;
+			for (it = offsets.begin(); it != offsets.end(); it++)
+			{
+				if (runs.empty() || it->first != runs[runs.size()-2] + runs[runs.size()-1])
+				{
+					runs.push_back(it->first);
+					runs.push_back(0);
+				}
+				runs[runs.size()-1]++;
+			}
+			putU32(data,runs.size() / 2);
+			for (int j=0; j<runs.size(); j++)
+				putU32(data,runs[j]);
+			floatSize += offsets.size() * 16;
+			if (!params.poseQuant)
+			{
+				for (it = offsets.begin(); it != offsets.end(); it++)
+				{
+					putFloat(data,it->second.x);
+					putFloat(data,it->second.y);
+					putFloat(data,it->second.z);
+				}
+				continue;
+			}
+			// quantise against the range of the pose offsets
+			Ogre::Vector3 min = offsets.empty() ? Ogre::Vector3::ZERO : offsets.begin()->second;
+			Ogre::Vector3 max = min;
+			for (it = offsets.begin(); it != offsets.end(); it++)
+			{
+				min.makeFloor(it->second);
+				max.makeCeil(it->second);
+			}
+			Ogre::Vector3 extent = max - min;
+			for (int c=0; c<3; c++)
+				putFloat(data,min[c]);
+			for (int c=0; c<3; c++)
+				putFloat(data,extent[c]);
+			for (it = offsets.begin(); it != offsets.end(); it++)
+			{
+				for (int c=0; c<3; c++)
+				{
+					uint16_t q = quantiseValue(it->second[c],min[c],extent[c]);
+					putU16(data,q);
+					maxError = std::max(maxError,(float)fabs(dequantiseValue(q,min[c],extent[c]) - it->second[c]));
+				}
+			}
+		}
+		// write the file
+		std::ofstream outPoses(filename.asChar(),std::ios::binary);
+		if (!outPoses)
+		{
+			std::cout << "Error opening file: " << filename.asChar() << "\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		outPoses.write((const char*)&data[0],data.size());
+		outPoses.close();
+		std::cout << "Wrote " << pMesh->getPoseCount() << " poses to " << filename.asChar() << ": " << data.size() << " bytes ("
+			<< floatSize << " bytes of indexed float offsets)\n";
+		if (params.poseQuant)
+			std::cout << "Maximum quantisation error: " << maxError << "\n";
+		std::cout.flush();
 		return MS::kSuccess;
 	}
 	// Create vertex animations for an Ogre mesh
@@ -1667,13 +2606,24 @@ namespace OgreMayaExporter
 				for (int k=0; k<t->m_vertexKeyframes.size(); k++)
 				{
 					Ogre::VertexPoseKeyFrame* pKeyframe = pTrack->createVertexPoseKeyFrame(t->m_vertexKeyframes[k].time);
+					// references to poses merged as duplicates add up their weights
+					std::vector<int> poseIndices;
+					std::vector<float> poseWeights;
 					for (int pri=0; pri<t->m_vertexKeyframes[k].poserefs.size(); pri++)
 					{
 						vertexPoseRef* pr = &t->m_vertexKeyframes[k].poserefs[pri];
 						// Get the correct absolute index of the pose from the remapping
 						int poseIndex = m_poseRemapping.find(t->m_index)->second.find(pr->poseIndex)->second;
-						pKeyframe->addPoseReference(poseIndex,pr->poseWeight);
+						int ref = std::find(poseIndices.begin(),poseIndices.end(),poseIndex) - poseIndices.begin();
+						if (ref == poseIndices.size())
+						{
+							poseIndices.push_back(poseIndex);
+							poseWeights.push_back(0);
+						}
+						poseWeights[ref] += pr->poseWeight;
 					}
+					for (int pri=0; pri<poseIndices.size(); pri++)
+						pKeyframe->addPoseReference(poseIndices[pri],poseWeights[pri]);
 				}
 			}
 		}
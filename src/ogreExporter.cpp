@@ -80,14 +80,16 @@ namespace OgreMayaExporter
 	// Execute the command
 	MStatus OgreExporter::doIt(const MArgList& args)
 	{
+		// Parse the arguments, before anything is changed
+		stat = m_params.parseArgs(args);
+		if (MS::kSuccess != stat)
+			return stat;
 		// clean up
 		delete m_pMesh;
 		delete m_pMaterialSet;
 		_vA_map.clear();
 		_firstStart = 1e12;
 		_lastStop = -1.;
-		// Parse the arguments.
-		m_params.parseArgs(args);
 		// Create output files
 		m_params.openFiles();
 		// Create a new empty mesh
@@ -131,20 +133,27 @@ namespace OgreMayaExporter
 				stat = translateNode(dagPath); 
 			}							
 		}
-		// Load vertex animations
-		if (m_params.exportVertAnims)
-			m_pMesh->loadAnims(m_params);
+		// Remove the joints that don't deform the mesh, before loading the animations
+		if (m_params.pruneBones && m_pMesh->getSkeleton())
+			m_pMesh->pruneBones(m_params);
+		// Order the joints breadth-first, after pruning and before the tracks are created
+		if (m_params.bfsBoneOrder && m_pMesh->getSkeleton())
+			m_pMesh->reorderBones(m_params);
+		// Choose the geometry layout, before loading any data that depends on it
+		if (m_params.autoSharedGeom)
+			m_pMesh->chooseGeometryLayout(m_params);
 		// Load blend shapes
 		if (m_params.exportBlendShapes)
 			m_pMesh->loadBlendShapes(m_params);
 		// Restore skeleton to correct pose
 		if (m_pMesh->getSkeleton())
 			m_pMesh->getSkeleton()->restorePose();
-		// Load skeleton animation (do it now, so we have loaded all needed joints)
-		if (m_pMesh->getSkeleton() && m_params.exportSkelAnims)
+		// Load skeleton, vertex and blend shape animations (do it now, so we have loaded all needed joints),
+		// every sampled time is evaluated only once for all clips
+		if (m_params.exportVertAnims || (m_params.exportBlendShapes && m_params.exportBSAnims) ||
+			(m_pMesh->getSkeleton() && m_params.exportSkelAnims))
 		{
-			// Load skeleton animations
-			m_pMesh->getSkeleton()->loadAnims(m_params);
+			m_pMesh->loadAnims(m_params);
 		}
 		/**************************** WRITE DATA **********************************/
 		stat = writeOgreData();
@@ -62,7 +62,59 @@
 // method to parse arguments from command line
 namespace OgreMayaExporter
 {
-	void ParamList::parseArgs(const MArgList &args)
+	// report an invalid value of a command option
+	static MStatus argError(const char* option,const MString& message)
+	{
+		MGlobal::displayError(MString("ogreExport ") + option + ": " + message);
+		return MS::kFailure;
+	}
+
+	// read the next argument of an option as a number
+	static MStatus readDouble(const MArgList& args,uint& i,const char* option,double& value)
+	{
+		MStatus stat;
+		value = args.asDouble(++i,&stat);
+		if (MS::kSuccess != stat)
+			return argError(option,"expected a number");
+		return MS::kSuccess;
+	}
+
+	// read the next argument of an option as an integer
+	static MStatus readInt(const MArgList& args,uint& i,const char* option,int& value)
+	{
+		MStatus stat;
+		value = args.asInt(++i,&stat);
+		if (MS::kSuccess != stat)
+			return argError(option,"expected an integer");
+		return MS::kSuccess;
+	}
+
+	// read the next argument of an option as a non empty string
+	static MStatus readString(const MArgList& args,uint& i,const char* option,MString& value)
+	{
+		MStatus stat;
+		value = args.asString(++i,&stat);
+		if (MS::kSuccess != stat || value.length() == 0)
+			return argError(option,"expected a value");
+		return MS::kSuccess;
+	}
+
+	// read the next argument of an option, which must be one of choices (separated by '|')
+	static MStatus readChoice(const MArgList& args,uint& i,const char* option,const char* choices,MString& value)
+	{
+		if (MS::kSuccess != readString(args,i,option,value))
+			return MS::kFailure;
+		MStringArray names;
+		MString(choices).split('|',names);
+		for (int k=0; k<names.length(); k++)
+		{
+			if (names[k] == value)
+				return MS::kSuccess;
+		}
+		return argError(option,MString("expected ") + choices + ", got " + value);
+	}
+
+	MStatus ParamList::parseArgs(const MArgList &args)
 	{
 		MStatus stat;
 		// Parse arguments from command line
@@ -125,6 +177,25 @@ namespace OgreMayaExporter
 				exportSkeleton = true;
 				skeletonFilename = args.asString(++i,&stat);
 			}
+			else if ((MString("-pruneBones") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				pruneBones = true;
+				MString pruneMode;
+				if (MS::kSuccess != readChoice(args,i,"-pruneBones","weighted|influences",pruneMode))
+					return MS::kFailure;
+				pruneKeepInfluences = (pruneMode == "influences");
+			}
+			else if ((MString("-keepBone") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				MString pattern;
+				if (MS::kSuccess != readString(args,i,"-keepBone",pattern))
+					return MS::kFailure;
+				keepBones.append(pattern);
+			}
+			else if ((MString("-bfsBones") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				bfsBoneOrder = true;
+			}
 			else if ((MString("-skeletonAnims") == args.asString(i,&stat)) && (MS::kSuccess == stat))
 			{
 				exportSkelAnims = true;
@@ -149,10 +220,145 @@ namespace OgreMayaExporter
 			{
 				skelBB = true;
 			}
+			else if ((MString("-autoRateTol") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				double tolerance;
+				if (MS::kSuccess != readDouble(args,i,"-autoRateTol",tolerance))
+					return MS::kFailure;
+				if (tolerance < 0)
+					return argError("-autoRateTol","the tolerance must not be negative");
+				autoRateTolerance = tolerance;
+			}
+			else if ((MString("-reduceKeys") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				reduceSkelKeys = true;
+				double tolTranslation, tolRotation, tolScale;
+				if (MS::kSuccess != readDouble(args,i,"-reduceKeys",tolTranslation) ||
+					MS::kSuccess != readDouble(args,i,"-reduceKeys",tolRotation) ||
+					MS::kSuccess != readDouble(args,i,"-reduceKeys",tolScale))
+					return MS::kFailure;
+				if (tolTranslation < 0 || tolRotation < 0 || tolScale < 0)
+					return argError("-reduceKeys","tolerances must not be negative");
+				skelKeyTolTranslation = tolTranslation;
+				skelKeyTolRotation = tolRotation;
+				skelKeyTolScale = tolScale;
+			}
+			else if ((MString("-quantAnims") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				exportQuantAnims = true;
+			}
+			else if ((MString("-boneTex") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				exportBoneTextures = true;
+				MString texFormat, texFile;
+				double rate;
+				if (MS::kSuccess != readChoice(args,i,"-boneTex","float|half",texFormat) ||
+					MS::kSuccess != readChoice(args,i,"-boneTex","dds|raw",texFile) ||
+					MS::kSuccess != readDouble(args,i,"-boneTex",rate))
+					return MS::kFailure;
+				if (rate <= 0)
+					return argError("-boneTex","the sample rate must be positive");
+				boneTexHalf = (texFormat == "half");
+				boneTexDDS = (texFile != "raw");
+				boneTexRate = rate;
+			}
+			else if ((MString("-animCache") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				if (MS::kSuccess != readString(args,i,"-animCache",animCacheFile))
+					return MS::kFailure;
+			}
+			else if ((MString("-animLod") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				animLodInfo lod;
+				double rate;
+				MString lodMode;
+				if (MS::kSuccess != readDouble(args,i,"-animLod",rate) ||
+					MS::kSuccess != readChoice(args,i,"-animLod","depth|weight",lodMode))
+					return MS::kFailure;
+				if (rate <= 0)
+					return argError("-animLod","the sample rate must be positive");
+				lod.rate = rate;
+				lod.byWeight = (lodMode == "weight");
+				lod.maxDepth = 0;
+				lod.minWeight = 0;
+				if (lod.byWeight)
+				{
+					double minWeight;
+					if (MS::kSuccess != readDouble(args,i,"-animLod",minWeight))
+						return MS::kFailure;
+					if (minWeight < 0 || minWeight > 1)
+						return argError("-animLod","the weight share must be between 0 and 1");
+					lod.minWeight = minWeight;
+				}
+				else
+				{
+					if (MS::kSuccess != readInt(args,i,"-animLod",lod.maxDepth))
+						return MS::kFailure;
+					if (lod.maxDepth < 0)
+						return argError("-animLod","the depth must not be negative");
+				}
+				animLods.push_back(lod);
+			}
+			else if ((MString("-boneBounds") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				exportBoneBounds = true;
+				double weight;
+				if (MS::kSuccess != readDouble(args,i,"-boneBounds",weight))
+					return MS::kFailure;
+				if (weight < 0 || weight > 1)
+					return argError("-boneBounds","the weight must be between 0 and 1");
+				boneBoundsWeight = weight;
+			}
+			else if ((MString("-skelLibrary") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				if (MS::kSuccess != readString(args,i,"-skelLibrary",skeletonLibraryDir))
+					return MS::kFailure;
+			}
+			else if ((MString("-clipSkeletons") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				splitClips = true;
+			}
+			else if ((MString("-clipGroup") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				MString groupName, pattern;
+				if (MS::kSuccess != readString(args,i,"-clipGroup",groupName) ||
+					MS::kSuccess != readString(args,i,"-clipGroup",pattern))
+					return MS::kFailure;
+				clipGroupNames.append(groupName);
+				clipGroupPatterns.append(pattern);
+			}
 			else if ((MString("-bsBB") == args.asString(i,&stat)) && (MS::kSuccess == stat))
 			{
 				bsBB = true;
 			}
+			else if ((MString("-bsDirect") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				bsDirect = true;
+			}
+			else if ((MString("-poseDedupe") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				poseDedupe = true;
+				// the tolerance is optional
+				if (i+1 < args.length())
+				{
+					double tolerance = args.asDouble(i+1,&stat);
+					if (MS::kSuccess == stat)
+					{
+						i++;
+						if (tolerance < 0)
+							return argError("-poseDedupe","the tolerance must not be negative");
+						poseDedupeTolerance = tolerance;
+					}
+				}
+			}
+			else if ((MString("-poseFile") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				exportPoseFile = true;
+				MString poseFormat;
+				if (MS::kSuccess != readChoice(args,i,"-poseFile","float|quant16",poseFormat))
+					return MS::kFailure;
+				poseQuant = (poseFormat == "quant16");
+			}
 			else if ((MString("-vertBB") == args.asString(i,&stat)) && (MS::kSuccess == stat))
 			{
 				vertBB = true;
@@ -223,6 +429,10 @@ namespace OgreMayaExporter
 			{
 				tangentsUseParity = true;
 			}
+			else if ((MString("-optimizeAttributes") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				optimizeAttributes = true;
+			}
 			else if ((MString("-camAnim") == args.asString(i,&stat)) && (MS::kSuccess == stat))
 			{
 				exportCamerasAnim = true;
@@ -237,9 +447,35 @@ namespace OgreMayaExporter
 				exportParticles = true;
 				particlesFilename = args.asString(++i,&stat);
 			}
+			else if ((MString("-threads") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				int n;
+				if (MS::kSuccess != readInt(args,i,"-threads",n))
+					return MS::kFailure;
+				if (n < 0)
+					return argError("-threads","the number of threads must not be negative");
+				numThreads = n;
+			}
 			else if ((MString("-shared") == args.asString(i,&stat)) && (MS::kSuccess == stat))
 			{
-				useSharedGeom = true;
+				// "-shared auto" picks the layout after loading, using the per-submesh layout while loading
+				if ((i+1 < args.length()) && (MString("auto") == args.asString(i+1,&stat)) && (MS::kSuccess == stat))
+				{
+					autoSharedGeom = true;
+					useSharedGeom = false;
+					i++;
+				}
+				else
+					useSharedGeom = true;
+			}
+			else if ((MString("-bindCost") == args.asString(i,&stat)) && (MS::kSuccess == stat))
+			{
+				double cost;
+				if (MS::kSuccess != readDouble(args,i,"-bindCost",cost))
+					return MS::kFailure;
+				if (cost < 0)
+					return argError("-bindCost","the cost must not be negative");
+				bindCost = cost;
 			}
 			else if ((MString("-np") == args.asString(i,&stat)) && (MS::kSuccess == stat))
 			{
@@ -298,6 +534,11 @@ namespace OgreMayaExporter
 						MTime t = MTime(intRate, MTime::uiUnit());
 						rate = t.as(MTime::kSeconds);
 					}
+					else if (sampleRateType == "sampleAuto")
+					{
+						// rate taken from the keys of the animation curves
+						rate = -1;
+					}
 					else
 					{
 						// rate specified in seconds
@@ -372,6 +613,11 @@ namespace OgreMayaExporter
 						MTime t = MTime(intRate, MTime::uiUnit());
 						rate = t.as(MTime::kSeconds);
 					}
+					else if (sampleRateType == "sampleAuto")
+					{
+						// rate taken from the keys of the animation curves
+						rate = -1;
+					}
 					else
 					{
 						// rate specified in seconds
@@ -446,6 +692,11 @@ namespace OgreMayaExporter
 						MTime t = MTime(intRate, MTime::uiUnit());
 						rate = t.as(MTime::kSeconds);
 					}
+					else if (sampleRateType == "sampleAuto")
+					{
+						// rate taken from the keys of the animation curves
+						rate = -1;
+					}
 					else
 					{
 						// rate specified in seconds
@@ -512,6 +763,26 @@ namespace OgreMayaExporter
 				}
 			}
 		}
+		vertexAttributes = buildVertexAttributeMask();
+		return MS::kSuccess;
+	}
+
+	// method to build the mask of vertex attributes to read from Maya, attributes
+	// that are not exported are never read, stored or used to split vertices.
+	// Bone weights are also read for the skeleton, whose bone pruning, weight based
+	// animation LODs and bone bounds need them even if bone assignments aren't written
+	unsigned int ParamList::buildVertexAttributeMask()
+	{
+		unsigned int mask = VA_POSITION;
+		if (exportVertNorm)
+			mask |= VA_NORMAL;
+		if (exportVertCol)
+			mask |= VA_COLOUR;
+		if (exportTexCoord)
+			mask |= VA_TEXCOORD;
+		if (exportVBA || exportSkeleton)
+			mask |= VA_BLENDWEIGHTS;
+		return mask;
 	}
 
 
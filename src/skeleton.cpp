@@ -55,8 +55,15 @@
 
 #include "skeleton.h"
 #include "submesh.h"
+#include "binaryData.h"
 #include <maya/MFnMatrixData.h>
 #include <maya/M3dView.h>
+#include <maya/MFnAnimCurve.h>
+#include <maya/MFnIkHandle.h>
+#include <maya/MFnAttribute.h>
+#include <algorithm>
+#include <stdio.h>
+#include <iterator>
 
 namespace OgreMayaExporter
 {
@@ -64,8 +71,10 @@ namespace OgreMayaExporter
 	Skeleton::Skeleton()
 	{
 		m_joints.clear();
+		m_jointIndices.clear();
 		m_animations.clear();
 		m_restorePose = "";
+		m_pPipeline = NULL;
 	}
 
 
@@ -80,7 +89,9 @@ namespace OgreMayaExporter
 	void Skeleton::clear()
 	{
 		m_joints.clear();
+		m_jointIndices.clear();
 		m_animations.clear();
+		m_levelStarts.clear();
 		m_restorePose = "";
 	}
 
@@ -115,16 +126,8 @@ namespace OgreMayaExporter
 					if (jointDag.hasFn(MFn::kJoint) && jointDag.length()>0)
 						rootDag = jointDag;
 				}
-				//check if skeleton has already been loaded
-				bool skip = false;
-				for (int j=0; j<m_joints.size() && !skip; j++)
-				{
-					//skip skeleton if already loaded
-					if (rootDag.partialPathName() == m_joints[j].name)
-					{
-						skip = true;
-					}
-				}
+				//skip skeleton if already loaded
+				bool skip = getJointIndex(rootDag.partialPathName()) >= 0;
 				//load joints data from root
 				if (!skip)
 				{
@@ -168,6 +171,13 @@ namespace OgreMayaExporter
 				}
 			}
 		}
+		// flag the joints used as influences by the skin cluster
+		for (int i=0; i<numInfluenceObjs; i++)
+		{
+			int idx = getJointIndex(influenceDags[i].partialPathName());
+			if (idx >= 0)
+				m_joints[idx].influence = true;
+		}
 
 		return MS::kSuccess;
 	}
@@ -200,13 +210,7 @@ namespace OgreMayaExporter
 			// Get parent index
 			int idx=-1;
 			if (parent)
-			{
-				for (int i=0; i<m_joints.size() && idx<0; i++)
-				{
-					if (m_joints[i].name == parent->name)
-						idx=i;
-				}
-			}
+				idx = getJointIndex(parent->name);
 			// Get world bind matrix
 			MMatrix bindMatrix = jointDag.inclusiveMatrix();;
 			// Calculate local bind matrix
@@ -217,64 +221,22 @@ namespace OgreMayaExporter
 			{	// root node of skeleton
 				localMatrix = bindMatrix;
 			}
-			// Get translation
-			MVector translation = ((MTransformationMatrix)localMatrix).translation(MSpace::kPostTransform);
-			if (fabs(translation.x) < PRECISION)
-				translation.x = 0;
-			if (fabs(translation.y) < PRECISION)
-				translation.y = 0;
-			if (fabs(translation.z) < PRECISION)
-				translation.z = 0;
-			// Calculate rotation data
-			double qx,qy,qz,qw;
-			((MTransformationMatrix)localMatrix).getRotationQuaternion(qx,qy,qz,qw);
-			MQuaternion rotation(qx,qy,qz,qw);
-			MVector axis;
-			double theta;
-			rotation.getAxisAngle(axis,theta);
-			if (fabs(axis.x) < PRECISION)
-				axis.x = 0;
-			if (fabs(axis.y) < PRECISION)
-				axis.y = 0;
-			if (fabs(axis.z) < PRECISION)
-				axis.z = 0;
-			axis.normalize();
-			if (fabs(theta) < PRECISION)
-				theta = 0;
-			if (axis.length() < 0.5)
-			{
-				axis.x = 0;
-				axis.y = 1;
-				axis.z = 0;
-				theta = 0;
-			}
-			// Get joint scale
-			double scale[3];
-			((MTransformationMatrix)localMatrix).getScale(scale,MSpace::kPostTransform);
-			if (fabs(scale[0]) < PRECISION)
-				scale[0] = 0;
-			if (fabs(scale[1]) < PRECISION)
-				scale[1] = 0;
-			if (fabs(scale[2]) < PRECISION)
-				scale[2] = 0;
 			// Set joint info
 			newJoint.name = jointFn.partialPathName();
 			newJoint.id = m_joints.size();
 			newJoint.parentIndex = idx;
 			newJoint.bindMatrix = bindMatrix;
-			newJoint.localMatrix = localMatrix;
-			newJoint.posx = translation.x * params.lum;
-			newJoint.posy = translation.y * params.lum;
-			newJoint.posz = translation.z * params.lum;
-			newJoint.angle = theta;
-			newJoint.axisx = axis.x;
-			newJoint.axisy = axis.y;
-			newJoint.axisz = axis.z;
-			newJoint.scalex = scale[0];
-			newJoint.scaley = scale[1];
-			newJoint.scalez = scale[2];
+			setBindPose(newJoint,localMatrix,params);
 			newJoint.jointDag = jointDag;
+			// joints parented directly under their parent joint get their world matrix
+			// from the local matrix of the node, others need a full inclusive matrix query
+			MDagPath parentDag = jointDag;
+			parentDag.pop();
+			newJoint.evalLocal = (idx >= 0) && (parentDag == m_joints[idx].jointDag);
+			newJoint.matrixPlug = jointFn.findPlug("matrix");
+			newJoint.influence = false;
 			m_joints.push_back(newJoint);
+			m_jointIndices[newJoint.name.asChar()] = newJoint.id;
 			// If root is a root joint, save its index in the roots list
 			if (idx < 0)
 			{
@@ -296,193 +258,24 @@ namespace OgreMayaExporter
 	}
 
 
-	// Load animations
-	MStatus Skeleton::loadAnims(ParamList& params)
-	{
-		MStatus stat;
-		// save current time for later restore
-		MTime curTime = MAnimControl::currentTime();
-		std::cout << "Loading joint animations...\n";
-		std::cout.flush();
-		// clear animations list
-		m_animations.clear();
-		// load skeleton animation clips for the whole skeleton
-		for (int i=0; i<params.skelClipList.size(); i++)
-		{
-			stat = loadClip(params.skelClipList[i].name,params.skelClipList[i].start,
-				params.skelClipList[i].stop,params.skelClipList[i].rate,params);
-			if (stat == MS::kSuccess)
-			{
-				std::cout << "Clip successfully loaded\n";
-				std::cout.flush();
-			}
-			else
-			{
-				std::cout << "Failed loading clip\n";
-				std::cout.flush();
-			}
-		}
-		//restore current time
-		MAnimControl::setCurrentTime(curTime);
-		return MS::kSuccess;
-	}
-
-	// Load an animation clip
-	MStatus Skeleton::loadClip(MString clipName,float start,float stop,float rate,ParamList& params)
-	{
-		MStatus stat;
-		MString msg;
-		std::vector<float> times;
-		// if skeleton has no joints we can't load the clip
-		if (m_joints.size() < 0)
-			return MS::kFailure;
-		// display clip name
-		std::cout << "clip \"" << clipName.asChar() << "\"\n";
-		std::cout.flush();
-		// calculate times from clip sample rate
-		times.clear();
-		if (rate <= 0)
-		{
-			std::cout << "invalid sample rate for the clip (must be >0), we skip it\n";
-			std::cout.flush();
-			return MS::kFailure;
-		}
-		for (float t=start; t<stop; t+=rate)
-			times.push_back(t);
-		times.push_back(stop);
-		// get animation length
-		float length=0;
-		if (times.size() >= 0)
-			length = times[times.size()-1] - times[0];
-		if (length < 0)
-		{
-			std::cout << "invalid time range for the clip, we skip it\n";
-			std::cout.flush();
-			return MS::kFailure;
-		}
-		// create the animation
-		Animation a;
-		a.m_name = clipName.asChar();
-		a.m_tracks.clear();
-		a.m_length = length;
-		m_animations.push_back(a);
-		int animIdx = m_animations.size() - 1;
-		// create a track for current clip for all joints
-		std::vector<Track> animTracks;
-		for (int i=0; i<m_joints.size(); i++)
-		{
-			Track t;
-			t.m_type = TT_SKELETON;
-			t.m_bone = m_joints[i].name;
-			t.m_skeletonKeyframes.clear();
-			animTracks.push_back(t);
-		}
-		// evaluate animation curves at selected times
-		for (int i=0; i<times.size(); i++)
-		{
-			//set time to wanted sample time
-			MAnimControl::setCurrentTime(MTime(times[i],MTime::kSeconds));
-			//load a keyframe for every joint at current time
-			for (int j=0; j<m_joints.size(); j++)
-			{
-				skeletonKeyframe key = loadKeyframe(m_joints[j],times[i]-times[0],params);
-				//add keyframe to joint track
-				animTracks[j].addSkeletonKeyframe(key);
-			}
-			if (params.skelBB)
-			{
-				// Update bounding boxes of loaded submeshes
-				for (int j=0; j<params.loadedSubmeshes.size(); j++)
-				{
-					MFnMesh mesh(params.loadedSubmeshes[j]->m_dagPath);
-					MPoint min = mesh.boundingBox().min();
-					MPoint max = mesh.boundingBox().max();
-					MBoundingBox bbox(min,max);
-					if (params.exportWorldCoords)
-						bbox.transformUsing(params.loadedSubmeshes[j]->m_dagPath.inclusiveMatrix());
-					min = bbox.min() * params.lum;
-					max = bbox.max() * params.lum;
-					MBoundingBox newbbox(min,max);
-					params.loadedSubmeshes[j]->m_boundingBox.expand(newbbox);
-				}
-			}
-		}
-		// add created tracks to current clip
-		for (int i=0; i<animTracks.size(); i++)
-		{
-			m_animations[animIdx].addTrack(animTracks[i]);
-		}
-		// display info
-		std::cout << "length: " << m_animations[animIdx].m_length << "\n";
-		std::cout << "num keyframes: " << animTracks[0].m_skeletonKeyframes.size() << "\n";
-		std::cout.flush();
-		// clip successfully loaded
-		return MS::kSuccess;
-	}
-
-	// test for shear(non-uniform scale)
-	void Skeleton::testShear( MString& aName, MMatrix& aTestMatrix, const std::string& aReason )
+	// Set the local bind pose of a joint
+	void Skeleton::setBindPose(joint& j,const MMatrix& localMatrix,ParamList& params)
 	{
-        // Warn if the matrix contains shear, Ogre doesn't support this		
-        double shear[3];
-        ((MTransformationMatrix)aTestMatrix).getShear(shear, MSpace::kPostTransform);
-        if( shear[0] >= PRECISION || shear[1] >= PRECISION || shear[2] >= PRECISION )
-      {
-         cout << "Warning: Animation keyframe matrix for joint [" << aName.asChar() << "] contains non-zero shear! -- " << aReason << "\n";
-         MGlobal::displayWarning( "Shearing Detected.  See Output." );
-      }
-   }
-
-	// Load a keyframe for a given joint at current time
-	skeletonKeyframe Skeleton::loadKeyframe(joint& j,float time,ParamList& params)
-	{
-		MVector position;
-		int parentIdx = j.parentIndex;
-		// Get joint matrix
-		MMatrix worldMatrix = j.jointDag.inclusiveMatrix();
-		// Calculate Local Matrix
-		MMatrix localMatrix;
-		if (parentIdx >= 0)
-		{
-			// Get parent joint
-			MDagPath parentDag = m_joints[parentIdx].jointDag;
-			localMatrix = worldMatrix * parentDag.inclusiveMatrixInverse();
-		}
-		else
-		{	// Root node of skeleton
-			if (params.exportWorldCoords)
-				localMatrix = worldMatrix;
-			else
-				localMatrix = worldMatrix * j.jointDag.exclusiveMatrixInverse();
-		}
-		// Get relative transformation matrix
-		MMatrix relMatrix = localMatrix * j.localMatrix.inverse();
-		// test for non-uniform scale
-		testShear( j.name, relMatrix, "loadKeyframe result" );
-		// Get relative translation
-		MVector translation = ((MTransformationMatrix)localMatrix).translation(MSpace::kPostTransform) - 
-			((MTransformationMatrix)j.localMatrix).translation(MSpace::kPostTransform);
+		// Get translation
+		MVector translation = ((MTransformationMatrix)localMatrix).translation(MSpace::kPostTransform);
 		if (fabs(translation.x) < PRECISION)
 			translation.x = 0;
 		if (fabs(translation.y) < PRECISION)
 			translation.y = 0;
 		if (fabs(translation.z) < PRECISION)
 			translation.z = 0;
-		// Get relative rotation
+		// Calculate rotation data
 		double qx,qy,qz,qw;
-		((MTransformationMatrix)relMatrix).getRotationQuaternion(qx,qy,qz,qw);
+		((MTransformationMatrix)localMatrix).getRotationQuaternion(qx,qy,qz,qw);
 		MQuaternion rotation(qx,qy,qz,qw);
 		MVector axis;
 		double theta;
 		rotation.getAxisAngle(axis,theta);
-		while (theta > Ogre::Math::PI) 
-		{ 
-			theta -= Ogre::Math::TWO_PI; 
-		} 
-		while (theta < -Ogre::Math::PI) 
-		{ 
-			theta += Ogre::Math::TWO_PI; 
-		} 
 		if (fabs(axis.x) < PRECISION)
 			axis.x = 0;
 		if (fabs(axis.y) < PRECISION)
@@ -499,193 +292,1922 @@ namespace OgreMayaExporter
 			axis.z = 0;
 			theta = 0;
 		}
-		// Get relative scale
+		// Get joint scale
 		double scale[3];
-		((MTransformationMatrix)relMatrix).getScale(scale,MSpace::kPostTransform);
+		((MTransformationMatrix)localMatrix).getScale(scale,MSpace::kPostTransform);
 		if (fabs(scale[0]) < PRECISION)
 			scale[0] = 0;
 		if (fabs(scale[1]) < PRECISION)
 			scale[1] = 0;
 		if (fabs(scale[2]) < PRECISION)
 			scale[2] = 0;
+		// Set joint info
+		j.localMatrix = localMatrix;
+		j.invLocalMatrix = localMatrix.inverse();
+		j.posx = translation.x * params.lum;
+		j.posy = translation.y * params.lum;
+		j.posz = translation.z * params.lum;
+		j.angle = theta;
+		j.axisx = axis.x;
+		j.axisy = axis.y;
+		j.axisz = axis.z;
+		j.scalex = scale[0];
+		j.scaley = scale[1];
+		j.scalez = scale[2];
+	}
 
-		// if (params.skeletonOffset) {
-		// key.tx = translation.x * params.lum - initial[x];
 
-		//create keyframe
-		skeletonKeyframe key;
-		key.time = time;
-		key.tx = translation.x * params.lum;
-		key.ty = translation.y * params.lum;
-		key.tz = translation.z * params.lum;
-		key.angle = theta;
-		key.axis_x = axis.x;
-		key.axis_y = axis.y;
-		key.axis_z = axis.z;
-		key.sx = scale[0];
-		key.sy = scale[1];
-		key.sz = scale[2];
-		return key;
+	// check if a name matches a pattern with * and ? wildcards
+	static bool matchesPattern(const char* pattern,const char* name)
+	{
+		if (*pattern == '\0')
+			return *name == '\0';
+		if (*pattern == '*')
+			return matchesPattern(pattern+1,name) || (*name != '\0' && matchesPattern(pattern,name+1));
+		if (*name != '\0' && (*pattern == '?' || *pattern == *name))
+			return matchesPattern(pattern+1,name+1);
+		return false;
 	}
 
-
-	// Restore skeleton pose
-	void Skeleton::restorePose()
+	// Remove the joints that don't deform the mesh: joints without weighted vertices (or that are
+	// not influences of a skin cluster), not animated in any of the exported clips and not
+	// matching a keep pattern. Root joints are always kept, removed joints in the middle of a
+	// chain are folded into the bind pose of their children
+	MStatus Skeleton::pruneJoints(const std::vector<bool>& weighted,ParamList& params,std::vector<int>& remap)
 	{
-		//enable constraints, IK, etc...
-		MGlobal::executeCommand("doEnableNodeItems true all",true);
-		// save current selection list
-		MSelectionList selectionList;
-		MGlobal::getActiveSelectionList(selectionList);
-		// restore the pose on all parts of the skeleton
-		for (int i=0; i<m_roots.size(); i++)
+		// find the joints animated in any clip
+		std::vector<bool> animated(m_joints.size(),false);
+		if (params.exportSkelAnims)
 		{
-			MDagPath rootDag = m_joints[m_roots[i]].jointDag;
-			// select the root joint dag
-			MGlobal::selectByName(rootDag.fullPathName(),MGlobal::kReplaceList);
-			// restore pose
-			MString cmd = "dagPose -r -g -n \""+ m_restorePose;
-			cmd += "\"";
-			MGlobal::executeCommand(cmd,true);
+			MObjectArray curves;
+			if (TimelineSampler::hasAutoRate(params.skelClipList))
+				findAnimCurves(curves);
+			for (int i=0; i<params.skelClipList.size(); i++)
+			{
+				clipInfo ci = params.skelClipList[i];
+				std::vector<float> times;
+				if (TimelineSampler::getClipTimes(ci.start,ci.stop,ci.rate,curves,params.autoRateTolerance,times) != MS::kSuccess)
+					continue;
+				std::vector<bool> clipAnimated;
+				findAnimatedJoints(times,clipAnimated);
+				for (int j=0; j<m_joints.size(); j++)
+				{
+					if (clipAnimated[j])
+						animated[j] = true;
+				}
+			}
 		}
-		//restore selection list
-		MGlobal::setActiveSelectionList(selectionList,MGlobal::kReplaceList);
+		// select the joints to keep
+		std::vector<bool> keep(m_joints.size(),false);
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			bool used = params.pruneKeepInfluences ? m_joints[j].influence : weighted[j];
+			keep[j] = used || animated[j] || m_joints[j].parentIndex < 0;
+			for (unsigned int k=0; k<params.keepBones.length() && !keep[j]; k++)
+				keep[j] = matchesPattern(params.keepBones[k].asChar(),m_joints[j].name.asChar());
+		}
+		// renumber the kept joints, parents come before their children so they are renumbered first
+		std::vector<joint> keptJoints;
+		remap.assign(m_joints.size(),-1);
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			if (!keep[j])
+			{
+				std::cout << "Pruning joint " << m_joints[j].name.asChar() << "\n";
+				std::cout.flush();
+				continue;
+			}
+			joint newJoint = m_joints[j];
+			newJoint.id = keptJoints.size();
+			// attach the joint to its closest kept ancestor
+			int parentIdx = m_joints[j].parentIndex;
+			while (parentIdx >= 0 && !keep[parentIdx])
+				parentIdx = m_joints[parentIdx].parentIndex;
+			if (parentIdx != m_joints[j].parentIndex)
+			{
+				setBindPose(newJoint,newJoint.bindMatrix * m_joints[parentIdx].bindMatrix.inverse(),params);
+				// the dag parent is not the parent joint any more
+				newJoint.evalLocal = false;
+			}
+			newJoint.parentIndex = parentIdx >= 0 ? remap[parentIdx] : -1;
+			remap[j] = newJoint.id;
+			keptJoints.push_back(newJoint);
+		}
+		std::cout << "Pruned " << m_joints.size() - keptJoints.size() << " of " << m_joints.size() << " joints\n";
+		std::cout.flush();
+		m_joints.swap(keptJoints);
+		m_jointIndices.clear();
+		for (int j=0; j<m_joints.size(); j++)
+			m_jointIndices[m_joints[j].name.asChar()] = j;
+		for (int i=0; i<m_roots.size(); i++)
+			m_roots[i] = remap[m_roots[i]];
+		return MS::kSuccess;
 	}
 
-
-
-	// Get joint list
-	std::vector<joint>& Skeleton::getJoints()
+	// Renumber the joints breadth-first: roots first, then the joints of each following level,
+	// with the children of a joint kept contiguous. Parents always get a lower index than their
+	// children, so the hierarchy can be updated in one pass, one level at a time
+	MStatus Skeleton::reorderJoints(ParamList& params,std::vector<int>& remap)
 	{
-		return m_joints;
+		// find the children of every joint, in their current order
+		std::vector<std::vector<int> > children(m_joints.size());
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			if (m_joints[j].parentIndex >= 0)
+				children[m_joints[j].parentIndex].push_back(j);
+		}
+		// visit the joints level by level
+		std::vector<int> order(m_roots.begin(),m_roots.end());
+		m_levelStarts.clear();
+		int levelStart = 0;
+		while (levelStart < order.size())
+		{
+			int levelEnd = order.size();
+			m_levelStarts.push_back(levelStart);
+			for (int i=levelStart; i<levelEnd; i++)
+				order.insert(order.end(),children[order[i]].begin(),children[order[i]].end());
+			levelStart = levelEnd;
+		}
+		if (order.size() != m_joints.size())
+		{
+			std::cout << "Error reordering joints: " << m_joints.size() - order.size() << " joints are not reachable from the roots\n";
+			std::cout.flush();
+			m_levelStarts.clear();
+			return MS::kFailure;
+		}
+		// renumber the joints
+		remap.assign(m_joints.size(),-1);
+		for (int i=0; i<order.size(); i++)
+			remap[order[i]] = i;
+		std::vector<joint> orderedJoints(m_joints.size());
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			joint& newJoint = orderedJoints[remap[j]];
+			newJoint = m_joints[j];
+			newJoint.id = remap[j];
+			if (newJoint.parentIndex >= 0)
+				newJoint.parentIndex = remap[newJoint.parentIndex];
+		}
+		m_joints.swap(orderedJoints);
+		m_jointIndices.clear();
+		for (int j=0; j<m_joints.size(); j++)
+			m_jointIndices[m_joints[j].name.asChar()] = j;
+		for (int i=0; i<m_roots.size(); i++)
+			m_roots[i] = remap[m_roots[i]];
+		std::cout << "Ordered " << m_joints.size() << " joints breadth-first in " << m_levelStarts.size() << " levels\n";
+		std::cout.flush();
+		return MS::kSuccess;
 	}
 
-
-
-	// Get animations
-	std::vector<Animation>& Skeleton::getAnimations()
+	// Register animation clips with the timeline sampler
+	MStatus Skeleton::registerAnims(TimelineSampler& sampler,ParamList& params)
 	{
-		return m_animations;
+		std::cout << "Loading joint animations...\n";
+		std::cout.flush();
+		// clear animations list
+		m_animations.clear();
+		m_animatedJoints.clear();
+		m_staticMatrices.clear();
+		m_clipFingerprints.clear();
+		// if skeleton has no joints we can't load the clips
+		if (m_joints.size() <= 0)
+			return MS::kFailure;
+		// the cache fingerprints depend on the animation curves
+		bool useCache = params.animCacheFile != "";
+		if (useCache)
+			loadAnimCache(params);
+		MObjectArray curves, cacheCurves;
+		if (TimelineSampler::hasAutoRate(params.skelClipList))
+			findAnimCurves(curves);
+		// the fingerprints also cover driven keys, which change the joints without being time based
+		if (useCache)
+			findAnimCurves(cacheCurves,true);
+		for (int i=0; i<params.skelClipList.size(); i++)
+		{
+			clipInfo ci = params.skelClipList[i];
+			// display clip name
+			std::cout << "clip \"" << ci.name.asChar() << "\"\n";
+			std::cout.flush();
+			// reuse the keyframes of a clip that didn't change since the previous export
+			uint64_t fingerprint = 0;
+			if (useCache)
+			{
+				fingerprint = getClipFingerprint(ci,cacheCurves,params);
+				int cached = 0;
+				while (cached < m_cachedAnims.size() &&
+					(m_cachedFingerprints[cached] != fingerprint || m_cachedAnims[cached].m_name != ci.name))
+					cached++;
+				if (cached < m_cachedAnims.size())
+				{
+					std::cout << "unchanged, using cached keyframes\n";
+					std::cout.flush();
+					m_animations.push_back(m_cachedAnims[cached]);
+					m_animatedJoints.push_back(std::vector<bool>());
+					m_staticMatrices.push_back(std::vector<MMatrix>());
+					m_clipFingerprints.push_back(fingerprint);
+					continue;
+				}
+			}
+			// calculate times from clip sample rate
+			std::vector<float> times;
+			if (TimelineSampler::getClipTimes(ci.start,ci.stop,ci.rate,curves,params.autoRateTolerance,times) != MS::kSuccess)
+				continue;
+			// joints that don't move during the clip are only read at its first key
+			std::vector<bool> animated;
+			findAnimatedJoints(times,animated);
+			int numAnimated = 0;
+			for (int j=0; j<animated.size(); j++)
+			{
+				if (animated[j])
+					numAnimated++;
+			}
+			std::cout << numAnimated << " of " << m_joints.size() << " joints are animated\n";
+			std::cout.flush();
+			// create the animation, with a track for every joint
+			Animation a;
+			a.m_name = ci.name;
+			a.m_length = times[times.size()-1] - times[0];
+			for (int j=0; j<m_joints.size(); j++)
+			{
+				Track t;
+				t.m_type = TT_SKELETON;
+				t.m_bone = m_joints[j].name;
+				// keyframes are filled by the workers in any order, static joints get a single keyframe
+				t.m_skeletonKeyframes.resize(animated[j] ? times.size() : 1);
+				a.addTrack(t);
+			}
+			m_animations.push_back(a);
+			m_animatedJoints.push_back(animated);
+			m_staticMatrices.push_back(std::vector<MMatrix>(m_joints.size()));
+			m_clipFingerprints.push_back(fingerprint);
+			sampler.addClip(this,SC_SKELETON,m_animations.size()-1,times);
+		}
+		return MS::kSuccess;
 	}
 
-
-
-	// Write to an OGRE binary skeleton
-	MStatus Skeleton::writeOgreBinary(ParamList &params)
+	// check if the value of a plug may change at the given times, the plug is static if it is
+	// not connected, or if it is keyed by time with the same value at all times
+	static bool plugChanges(const MPlug& plug,const std::vector<float>& times,int depth = 0)
 	{
 		MStatus stat;
-		// Construct skeleton
-		MString name = "exportSkeleton";
-		Ogre::SkeletonPtr pSkeleton = Ogre::SkeletonManager::getSingleton().create(name.asChar(), 
-			Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-		// Create skeleton bones
-		stat = createOgreBones(pSkeleton,params);
-		if (stat != MS::kSuccess)
-		{
-			std::cout << "Error writing skeleton binary file\n";
-			std::cout.flush();
+		MPlugArray sources;
+		plug.connectedTo(sources,true,false,&stat);
+		if (sources.length() > 0)
+		{
+			MObject source = sources[0].node();
+			if (source.hasFn(MFn::kAnimCurve))
+			{
+				MFnAnimCurve curveFn(source);
+				// driven keys depend on other attributes
+				if (!curveFn.isTimeInput())
+					return true;
+				double first = curveFn.evaluate(MTime(times[0],MTime::kSeconds));
+				for (int i=1; i<times.size(); i++)
+				{
+					if (fabs(curveFn.evaluate(MTime(times[i],MTime::kSeconds)) - first) > PRECISION)
+						return true;
+				}
+				return false;
+			}
+			// a direct connection from an input attribute of another transform (like the
+			// parent scale to inverseScale) is static if that attribute is
+			if (source.hasFn(MFn::kTransform) && depth < 8 && MFnAttribute(sources[0].attribute()).isWritable())
+				return plugChanges(sources[0],times,depth+1);
+			// expressions, constraints, utility nodes...
+			return true;
 		}
-		// Create skeleton animation
-		if (params.exportSkelAnims)
+		for (unsigned int i=0; i<plug.numChildren(); i++)
 		{
-			stat = createOgreSkeletonAnimations(pSkeleton,params);
-			if (stat != MS::kSuccess)
+			if (plugChanges(plug.child(i),times,depth))
+				return true;
+		}
+		return false;
+	}
+
+	// Find the animation curves driving the joints
+	void Skeleton::findAnimCurves(MObjectArray& curves,bool drivenKeys)
+	{
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			TimelineSampler::findAnimCurves(m_joints[j].jointDag.node(),curves,drivenKeys);
+			// joints evaluated from their world matrix depend on their dag parents
+			if (!m_joints[j].evalLocal)
 			{
-				std::cout << "Error writing ogre skeleton animations\n";
-				std::cout.flush();
+				MDagPath path = m_joints[j].jointDag;
+				path.pop();
+				while (path.length() > 0)
+				{
+					TimelineSampler::findAnimCurves(path.node(),curves,drivenKeys);
+					path.pop();
+				}
 			}
 		}
-		pSkeleton->setBindingPose();
-		// Optimise animations
-		pSkeleton->optimiseAllAnimations();
-		// Export skeleton binary
-		Ogre::SkeletonSerializer serializer;
-		serializer.exportSkeleton(pSkeleton.getPointer(),params.skeletonFilename.asChar());
-		pSkeleton.setNull();
-		// Skeleton successfully exported
-		return MS::kSuccess;
+		// ik handles posing the joints
+		for (MItDependencyNodes it(MFn::kIkHandle); !it.isDone(); it.next())
+		{
+			MFnIkHandle handleFn(it.thisNode());
+			MDagPath startJoint;
+			if (!handleFn.getStartJoint(startJoint))
+				continue;
+			if (getJointIndex(startJoint.partialPathName()) >= 0)
+				TimelineSampler::findAnimCurves(it.thisNode(),curves,drivenKeys);
+		}
 	}
 
-	// Write joints to an Ogre skeleton
-	MStatus Skeleton::createOgreBones(Ogre::SkeletonPtr pSkeleton,ParamList& params)
+	// Find the joints whose local matrix may change during a clip
+	void Skeleton::findAnimatedJoints(const std::vector<float>& times,std::vector<bool>& animated)
 	{
-		// Create the bones
-		for (int i=0; i<m_joints.size(); i++)
+		animated.assign(m_joints.size(),false);
+		// joints in an IK chain are posed by the solver
+		std::vector<bool> inIkChain(m_joints.size(),false);
+		for (MItDependencyNodes it(MFn::kIkHandle); !it.isDone(); it.next())
 		{
-			joint* j = &m_joints[i];
-			// Create a new bone
-			Ogre::String jointName = j->name.asChar();
-			int jointId = j->id;
-			Ogre::Bone* pBone = pSkeleton->createBone(jointName, jointId);
-			// Set bone position (relative to it's parent)
-			pBone->setPosition(j->posx,j->posy,j->posz);
-			// Set bone orientation (relative to it's parent)
-			Ogre::Quaternion orient;
-			orient.FromAngleAxis(Ogre::Radian(j->angle),Ogre::Vector3(j->axisx,j->axisy,j->axisz));
-			pBone->setOrientation(orient);
-			// Set bone scale (relative to it's parent)
-			pBone->setScale(j->scalex,j->scaley,j->scalez);
+			MFnIkHandle handleFn(it.thisNode());
+			MDagPath startJoint, effector;
+			if (!handleFn.getStartJoint(startJoint) || !handleFn.getEffector(effector))
+				continue;
+			MDagPath chainJoint = effector;
+			while (chainJoint.length() > 1 && !(chainJoint == startJoint))
+			{
+				chainJoint.pop();
+				int j = getJointIndex(chainJoint.partialPathName());
+				if (j >= 0)
+					inIkChain[j] = true;
+			}
 		}
-		// Create the hierarchy
-		for (int i=0; i<m_joints.size(); i++)
+		for (int j=0; j<m_joints.size(); j++)
 		{
-			joint* j = &m_joints[i];
-			int parentIdx = j->parentIndex;
-			if (parentIdx >= 0)
+			// joints evaluated from their world matrix depend on other nodes of the hierarchy
+			if (!m_joints[j].evalLocal || inIkChain[j])
 			{
-				// Get the parent joint
-				joint* parentJoint = &m_joints[parentIdx];
-				unsigned short parentId = m_joints[parentIdx].id;
-				Ogre::String parentName = parentJoint->name.asChar();
-				Ogre::Bone* pParent = pSkeleton->getBone(parentName);
-				// Get current joint from skeleton
-				unsigned short jointId = j->id;
-				Ogre::String jointName = j->name.asChar();
-				Ogre::Bone* pBone = pSkeleton->getBone(jointName);
-				// Place current bone in the parent's child list
-				pParent->addChild(pBone);
+				animated[j] = true;
+				continue;
+			}
+			// check the drivers of every attribute the local matrix depends on
+			MFnDependencyNode jointFn(m_joints[j].jointDag.node());
+			MObjectArray attributes;
+			jointFn.getAffectedByAttributes(m_joints[j].matrixPlug.attribute(),attributes);
+			for (unsigned int i=0; i<attributes.length() && !animated[j]; i++)
+			{
+				MPlug plug(m_joints[j].jointDag.node(),attributes[i]);
+				if (plugChanges(plug,times))
+					animated[j] = true;
 			}
 		}
-		return MS::kSuccess;
 	}
 
+	// Prepare the frame pipeline
+	MStatus Skeleton::beginSampling(ParamList& params)
+	{
+		m_pPipeline = new FramePipeline(params.numThreads);
+		m_frames.resize(m_pPipeline->numSlots());
+		for (int i=0; i<m_frames.size(); i++)
+		{
+			m_frames[i].localMatrices.resize(m_joints.size());
+			m_frames[i].worldMatrices.resize(m_joints.size());
+			m_frames[i].rootMatrices.resize(m_joints.size());
+			m_frames[i].relMatrices.resize(m_joints.size());
+		}
+		m_shearedJoints.clear();
+		return MS::kSuccess;
+	}
 
-	// Write skeleton animations to an Ogre skeleton
-	MStatus Skeleton::createOgreSkeletonAnimations(Ogre::SkeletonPtr pSkeleton,ParamList& params)
+	// Capture the joint matrices for a clip at current time. Reading the matrices is all
+	// that needs the Maya main thread, the keyframes are computed on a worker thread
+	MStatus Skeleton::sample(sampleChannel channel,int clip,int key,float clipTime,ParamList& params)
 	{
-		// Read loaded skeleton animations
-		for (int i=0; i<m_animations.size(); i++)
+		unsigned int slot = m_pPipeline->acquireSlot();
+		skeletonFrame& frame = m_frames[slot];
+		frame.clip = clip;
+		frame.key = key;
+		frame.clipTime = clipTime;
+		// read each joint transform once, world matrices are built top-down on the worker
+		for (int j=0; j<m_joints.size(); j++)
 		{
-			// Create a new animation
-			Ogre::Animation* pAnimation = pSkeleton->createAnimation(m_animations[i].m_name.asChar(),
-				m_animations[i].m_length);
-			// Create tracks for current animation
-			for (int j=0; j<m_animations[i].m_tracks.size(); j++)
+			if (!m_animatedJoints[clip][j])
 			{
-				Track* t = &m_animations[i].m_tracks[j];
-				// Create a new track
-				Ogre::NodeAnimationTrack* pTrack = pAnimation->createNodeTrack(j,
-					pSkeleton->getBone(t->m_bone.asChar()));
-				// Create keyframes for current track
-				for (int k=0; k<t->m_skeletonKeyframes.size(); k++)
+				// static joints are read at the first key of the clip only
+				if (key == 0)
 				{
-					skeletonKeyframe* keyframe = &t->m_skeletonKeyframes[k];
-					// Create a new keyframe
-					Ogre::TransformKeyFrame* pKeyframe = pTrack->createNodeKeyFrame(keyframe->time);
-					// Set translation
-					pKeyframe->setTranslate(Ogre::Vector3(keyframe->tx,keyframe->ty,keyframe->tz));
-					// Set rotation
-					Ogre::Quaternion rot;
-					rot.FromAngleAxis(Ogre::Radian(keyframe->angle),
-						Ogre::Vector3(keyframe->axis_x,keyframe->axis_y,keyframe->axis_z));
-					pKeyframe->setRotation(rot);
-					// Set scale
-					pKeyframe->setScale(Ogre::Vector3(keyframe->sx,keyframe->sy,keyframe->sz));
+					MObject matrixData = m_joints[j].matrixPlug.asMObject();
+					m_staticMatrices[clip][j] = MFnMatrixData(matrixData).matrix();
 				}
+				frame.localMatrices[j] = m_staticMatrices[clip][j];
+			}
+			else if (m_joints[j].evalLocal)
+			{
+				MObject matrixData = m_joints[j].matrixPlug.asMObject();
+				frame.localMatrices[j] = MFnMatrixData(matrixData).matrix();
 			}
+			else
+				frame.worldMatrices[j] = m_joints[j].jointDag.inclusiveMatrix();
+			if (m_joints[j].parentIndex < 0 && !params.exportWorldCoords)
+				frame.rootMatrices[j] = m_joints[j].jointDag.exclusiveMatrixInverse();
 		}
+		skeletonFrame* pFrame = &frame;
+		m_pPipeline->submit(slot,[this,pFrame,&params]()
+		{
+			processFrame(*pFrame,params);
+		});
 		return MS::kSuccess;
 	}
-	
+
+	// Wait for the pending keyframes and release the frame pipeline
+	MStatus Skeleton::endSampling(ParamList& params)
+	{
+		MStatus stat = MS::kSuccess;
+		try
+		{
+			m_pPipeline->wait();
+		}
+		catch (std::exception& e)
+		{
+			MGlobal::displayError(MString("Error computing skeleton keyframes: ") + e.what());
+			stat = MS::kFailure;
+		}
+		delete m_pPipeline;
+		m_pPipeline = NULL;
+		m_frames.clear();
+		// Warn if a keyframe contains shear, Ogre doesn't support this
+		for (std::set<int>::iterator it = m_shearedJoints.begin(); it != m_shearedJoints.end(); it++)
+		{
+			std::cout << "Warning: Animation keyframe matrix for joint [" << m_joints[*it].name.asChar() << "] contains non-zero shear! -- loadKeyframe result\n";
+			std::cout.flush();
+		}
+		if (m_shearedJoints.size() > 0)
+			MGlobal::displayWarning( "Shearing Detected.  See Output." );
+		return stat;
+	}
+
+	// Compute the keyframes of all joints from captured matrices
+	void Skeleton::processFrame(skeletonFrame& frame,ParamList& params)
+	{
+		Animation& a = m_animations[frame.clip];
+		// joints are stored parents first, so world matrices can be built in a single pass
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			if (m_joints[j].evalLocal)
+				frame.worldMatrices[j] = frame.localMatrices[j] * frame.worldMatrices[m_joints[j].parentIndex];
+		}
+		frame.keyJoints.clear();
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			// static joints only have a keyframe at the start of the clip
+			if (frame.key > 0 && !m_animatedJoints[frame.clip][j])
+				continue;
+			// Calculate Local Matrix
+			MMatrix localMatrix;
+			int parentIdx = m_joints[j].parentIndex;
+			if (m_joints[j].evalLocal)
+				localMatrix = frame.localMatrices[j];
+			else if (parentIdx >= 0)
+				localMatrix = frame.worldMatrices[j] * frame.worldMatrices[parentIdx].inverse();
+			else if (params.exportWorldCoords)
+				localMatrix = frame.worldMatrices[j];
+			else
+				localMatrix = frame.worldMatrices[j] * frame.rootMatrices[j];
+			// rotation and scale are taken relative to the bind pose, translation
+			// is the offset from the bind pose translation
+			MMatrix& relMatrix = frame.relMatrices[frame.keyJoints.size()];
+			frame.keyJoints.push_back(j);
+			relMatrix = localMatrix * m_joints[j].invLocalMatrix;
+			for (int k=0; k<3; k++)
+				relMatrix.matrix[3][k] = localMatrix.matrix[3][k] - m_joints[j].localMatrix.matrix[3][k];
+		}
+		// decompose the relative matrices of all joints in one batch, the kernel reads
+		// the MMatrix array as plain 4x4 arrays of doubles
+		static_assert(sizeof(MMatrix) == 16*sizeof(double),"MMatrix is expected to only hold its elements");
+		decomposeMatrices(&frame.relMatrices[0].matrix,frame.keyJoints.size(),frame.decomposed);
+		for (int i=0; i<frame.keyJoints.size(); i++)
+		{
+			int j = frame.keyJoints[i];
+			loadKeyframe(frame.decomposed,i,a.m_tracks[j].m_skeletonKeyframes,frame.key,frame.clipTime,params);
+			// test for non-uniform scale, warnings are displayed from the main thread
+			const decomposedMatrices& d = frame.decomposed;
+			if (d.shxy[i] >= PRECISION || d.shxz[i] >= PRECISION || d.shyz[i] >= PRECISION)
+			{
+				std::lock_guard<std::mutex> lock(m_shearMutex);
+				m_shearedJoints.insert(j);
+			}
+		}
+	}
+
+	// Reduce the keyframes and print info about the loaded animations
+	void Skeleton::finaliseAnims(ParamList& params)
+	{
+		// cache the sampled keyframes, before they are reduced
+		if (params.animCacheFile != "")
+			saveAnimCache(params);
+		if (params.reduceSkelKeys)
+			reduceKeyframes(params);
+		for (int i=0; i<m_animations.size(); i++)
+		{
+			size_t numKeys = 0;
+			for (int j=0; j<m_animations[i].m_tracks.size(); j++)
+				numKeys += m_animations[i].m_tracks[j].m_skeletonKeyframes.size();
+			std::cout << "clip \"" << m_animations[i].m_name.asChar() << "\"\n";
+			std::cout << "length: " << m_animations[i].m_length << "\n";
+			std::cout << "num keyframes: " << numKeys << " in " << m_animations[i].m_tracks.size() << " tracks\n";
+			std::cout.flush();
+		}
+	}
+
+	/***** keyframe reduction *****/
+	// tolerances of a joint track
+	typedef struct keyToleranceTag
+	{
+		double translation;
+		double rotation;	//radians
+		double scale;
+	} keyTolerance;
+
+	// rotation of a keyframe
+	static inline Ogre::Quaternion keyframeRotation(const skeletonKeyframes& keys,int k)
+	{
+		return Ogre::Quaternion(keys.qw[k],keys.qx[k],keys.qy[k],keys.qz[k]);
+	}
+
+	// interpolate the keyframes of a track at a time, the way Ogre does by default
+	static void sampleKeyframes(const skeletonKeyframes& keys,float time,Ogre::Vector3& translation,Ogre::Quaternion& rotation,Ogre::Vector3& scale)
+	{
+		int b = std::upper_bound(keys.time.begin(),keys.time.end(),time) - keys.time.begin();
+		int a = std::max(b-1,0);
+		b = std::min(b,(int)keys.size()-1);
+		float length = keys.time[b] - keys.time[a];
+		float t = length > 0 ? (time - keys.time[a]) / length : 0;
+		translation = Ogre::Vector3(keys.tx[a] + (keys.tx[b] - keys.tx[a])*t,keys.ty[a] + (keys.ty[b] - keys.ty[a])*t,
+			keys.tz[a] + (keys.tz[b] - keys.tz[a])*t);
+		rotation = Ogre::Quaternion::nlerp(t,keyframeRotation(keys,a),keyframeRotation(keys,b),true);
+		scale = Ogre::Vector3(keys.sx[a] + (keys.sx[b] - keys.sx[a])*t,keys.sy[a] + (keys.sy[b] - keys.sy[a])*t,
+			keys.sz[a] + (keys.sz[b] - keys.sz[a])*t);
+	}
+
+	// check if the keys between first and last are rebuilt within tolerance by interpolating
+	// first and last, the way Ogre does by default (linear translation and scale, nlerp rotation)
+	static bool canDropKeys(const skeletonKeyframes& keys,int a,int b,const keyTolerance& tol)
+	{
+		Ogre::Quaternion qa = keyframeRotation(keys,a);
+		Ogre::Quaternion qb = keyframeRotation(keys,b);
+		double length = keys.time[b] - keys.time[a];
+		for (int k=a+1; k<b; k++)
+		{
+			double t = length > 0 ? (keys.time[k] - keys.time[a]) / length : 0;
+			// translation
+			double dx = keys.tx[a] + (keys.tx[b] - keys.tx[a])*t - keys.tx[k];
+			double dy = keys.ty[a] + (keys.ty[b] - keys.ty[a])*t - keys.ty[k];
+			double dz = keys.tz[a] + (keys.tz[b] - keys.tz[a])*t - keys.tz[k];
+			if (dx*dx + dy*dy + dz*dz > tol.translation*tol.translation)
+				return false;
+			// scale
+			if (fabs(keys.sx[a] + (keys.sx[b] - keys.sx[a])*t - keys.sx[k]) > tol.scale ||
+				fabs(keys.sy[a] + (keys.sy[b] - keys.sy[a])*t - keys.sy[k]) > tol.scale ||
+				fabs(keys.sz[a] + (keys.sz[b] - keys.sz[a])*t - keys.sz[k]) > tol.scale)
+				return false;
+			// rotation, angle between the interpolated and the sampled rotation
+			Ogre::Quaternion q = Ogre::Quaternion::nlerp(t,qa,qb,true);
+			double d = fabs(q.Dot(keyframeRotation(keys,k)));
+			if (d < 1 && 2*acos(d) > tol.rotation)
+				return false;
+		}
+		return true;
+	}
+
+	// reduce the keyframes of a track, the first and last keyframes are always kept
+	static void reduceTrack(skeletonKeyframes& keys,const keyTolerance& tol)
+	{
+		int numKeys = keys.size();
+		if (numKeys <= 2)
+			return;
+		std::vector<int> reduced;
+		reduced.push_back(0);
+		int start = 0;
+		while (start < numKeys-1)
+		{
+			// find the furthest key that can be interpolated from start, growing the span
+			// exponentially and then refining it with a binary search
+			int good = start + 1;
+			int step = 1;
+			while (good+step < numKeys && canDropKeys(keys,start,good+step,tol))
+			{
+				good += step;
+				step *= 2;
+			}
+			int bad = std::min(good+step,numKeys);
+			while (bad - good > 1)
+			{
+				int mid = (good + bad) / 2;
+				if (canDropKeys(keys,start,mid,tol))
+					good = mid;
+				else
+					bad = mid;
+			}
+			reduced.push_back(good);
+			start = good;
+		}
+		keys.keep(reduced);
+	}
+
+	// Drop keyframes that interpolation rebuilds within the reduction tolerances
+	void Skeleton::reduceKeyframes(ParamList& params)
+	{
+		// an error on a joint moves the whole chain below it, so rotation and scale errors
+		// are measured as the offset they cause at the end of the longest descendant chain
+		std::vector<double> chainLength(m_joints.size(),0);
+		for (int j=m_joints.size()-1; j>=0; j--)
+		{
+			int parentIdx = m_joints[j].parentIndex;
+			if (parentIdx >= 0)
+			{
+				double boneLength = sqrt(m_joints[j].posx*m_joints[j].posx + m_joints[j].posy*m_joints[j].posy +
+					m_joints[j].posz*m_joints[j].posz);
+				chainLength[parentIdx] = std::max(chainLength[parentIdx],chainLength[j] + boneLength);
+			}
+		}
+		std::vector<keyTolerance> tolerances(m_joints.size());
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			tolerances[j].translation = params.skelKeyTolTranslation;
+			tolerances[j].rotation = params.skelKeyTolRotation * Ogre::Math::PI / 180.0;
+			tolerances[j].scale = params.skelKeyTolScale;
+			if (chainLength[j] > 0)
+			{
+				tolerances[j].rotation = std::min(tolerances[j].rotation,params.skelKeyTolTranslation / chainLength[j]);
+				tolerances[j].scale = std::min(tolerances[j].scale,params.skelKeyTolTranslation / chainLength[j]);
+			}
+		}
+		// tracks are independent, reduce them on the worker threads
+		std::vector<Track*> tracks;
+		std::vector<int> trackJoints;
+		size_t keysBefore = 0, keysAfter = 0;
+		for (int i=0; i<m_animations.size(); i++)
+		{
+			for (int j=0; j<m_animations[i].m_tracks.size(); j++)
+			{
+				// LOD variants don't have a track for every joint
+				int jointIdx = getJointIndex(m_animations[i].m_tracks[j].m_bone);
+				if (jointIdx < 0)
+					continue;
+				tracks.push_back(&m_animations[i].m_tracks[j]);
+				trackJoints.push_back(jointIdx);
+				keysBefore += m_animations[i].m_tracks[j].m_skeletonKeyframes.size();
+			}
+		}
+		WorkerPool workers(params.numThreads);
+		workers.parallelFor(tracks.size(),[&](size_t i)
+		{
+			reduceTrack(tracks[i]->m_skeletonKeyframes,tolerances[trackJoints[i]]);
+		});
+		for (int i=0; i<tracks.size(); i++)
+			keysAfter += tracks[i]->m_skeletonKeyframes.size();
+		std::cout << "Reduced skeleton keyframes from " << keysBefore << " to " << keysAfter << "\n";
+		std::cout.flush();
+	}
+
+	/***** animation LOD *****/
+	// resample keyframes at a fixed time step, the first and last times are always sampled
+	static void resampleKeyframes(const skeletonKeyframes& keys,float length,float step,skeletonKeyframes& out)
+	{
+		if (keys.size() <= 1 || step <= 0)
+		{
+			out = keys;
+			return;
+		}
+		int numKeys = (int)ceil(length / step - 1e-4f) + 1;
+		out.resize(numKeys);
+		for (int k=0; k<numKeys; k++)
+		{
+			float time = std::min(k * step,length);
+			Ogre::Vector3 translation, scale;
+			Ogre::Quaternion rotation;
+			sampleKeyframes(keys,time,translation,rotation,scale);
+			out.time[k] = time;
+			out.tx[k] = translation.x; out.ty[k] = translation.y; out.tz[k] = translation.z;
+			out.qx[k] = rotation.x; out.qy[k] = rotation.y; out.qz[k] = rotation.z; out.qw[k] = rotation.w;
+			out.sx[k] = scale.x; out.sy[k] = scale.y; out.sz[k] = scale.z;
+		}
+	}
+
+	// Create the LOD variants of the sampled clips, named after the clip plus "_lod" and the level.
+	// Tracks are resampled at the level's lower rate, and only the joints selected by depth or by
+	// the share of the skin weight they deform (with their descendants) keep a track, the others
+	// stay in their bind pose. Parents always keep their track when a child does
+	void Skeleton::createLodAnims(const std::vector<float>& jointWeights,ParamList& params)
+	{
+		int numJoints = m_joints.size();
+		// depth of every joint and weight deformed by every joint and its descendants,
+		// parents come before their children
+		std::vector<int> depth(numJoints,0);
+		for (int j=0; j<numJoints; j++)
+		{
+			if (m_joints[j].parentIndex >= 0)
+				depth[j] = depth[m_joints[j].parentIndex] + 1;
+		}
+		std::vector<float> subtreeWeight(numJoints,0);
+		float totalWeight = 0;
+		for (int j=0; j<numJoints && j<jointWeights.size(); j++)
+		{
+			subtreeWeight[j] = jointWeights[j];
+			totalWeight += jointWeights[j];
+		}
+		for (int j=numJoints-1; j>=0; j--)
+		{
+			if (m_joints[j].parentIndex >= 0)
+				subtreeWeight[m_joints[j].parentIndex] += subtreeWeight[j];
+		}
+		int numClips = m_animations.size();
+		for (int l=0; l<params.animLods.size(); l++)
+		{
+			animLodInfo& lod = params.animLods[l];
+			// without skin weights no joint can be kept by weight
+			if (lod.byWeight && totalWeight <= 0)
+			{
+				std::cout << "Warning: no skin weights found, skipping animation LOD " << l+1 << "\n";
+				std::cout.flush();
+				continue;
+			}
+			std::vector<bool> keep(numJoints);
+			int numKept = 0;
+			for (int j=0; j<numJoints; j++)
+			{
+				if (lod.byWeight)
+					keep[j] = totalWeight > 0 && subtreeWeight[j] / totalWeight >= lod.minWeight;
+				else
+					keep[j] = depth[j] <= lod.maxDepth;
+				if (keep[j])
+					numKept++;
+			}
+			if (numKept == 0)
+			{
+				std::cout << "Warning: animation LOD " << l+1 << " keeps no joints, skipped\n";
+				std::cout.flush();
+				continue;
+			}
+			float step = lod.rate > 0 ? 1.0f / lod.rate : 0;
+			for (int i=0; i<numClips; i++)
+			{
+				Animation lodAnim;
+				lodAnim.m_name = m_animations[i].m_name;
+				lodAnim.m_name += "_lod";
+				lodAnim.m_name += l+1;
+				lodAnim.m_length = m_animations[i].m_length;
+				for (int j=0; j<m_animations[i].m_tracks.size(); j++)
+				{
+					Track& t = m_animations[i].m_tracks[j];
+					int jointIdx = getJointIndex(t.m_bone);
+					if (jointIdx < 0 || !keep[jointIdx])
+						continue;
+					Track lodTrack;
+					lodTrack.m_type = TT_SKELETON;
+					lodTrack.m_bone = t.m_bone;
+					resampleKeyframes(t.m_skeletonKeyframes,lodAnim.m_length,step,lodTrack.m_skeletonKeyframes);
+					lodAnim.addTrack(lodTrack);
+				}
+				m_animations.push_back(lodAnim);
+			}
+			std::cout << "Animation LOD " << l+1 << ": " << lod.rate << " keys per second on " << numKept << " of " << numJoints << " joints\n";
+			std::cout.flush();
+		}
+	}
+
+	// test for shear(non-uniform scale)
+	void Skeleton::testShear( MString& aName, MMatrix& aTestMatrix, const std::string& aReason )
+	{
+        // Warn if the matrix contains shear, Ogre doesn't support this		
+        double shear[3];
+        ((MTransformationMatrix)aTestMatrix).getShear(shear, MSpace::kPostTransform);
+        if( shear[0] >= PRECISION || shear[1] >= PRECISION || shear[2] >= PRECISION )
+      {
+         cout << "Warning: Animation keyframe matrix for joint [" << aName.asChar() << "] contains non-zero shear! -- " << aReason << "\n";
+         MGlobal::displayWarning( "Shearing Detected.  See Output." );
+      }
+   }
+
+	// Store a keyframe from a decomposed relative matrix
+	void Skeleton::loadKeyframe(const decomposedMatrices& d,int index,skeletonKeyframes& keys,int key,float time,ParamList& params)
+	{
+		// Get relative translation
+		MVector translation(d.tx[index],d.ty[index],d.tz[index]);
+		if (fabs(translation.x) < PRECISION)
+			translation.x = 0;
+		if (fabs(translation.y) < PRECISION)
+			translation.y = 0;
+		if (fabs(translation.z) < PRECISION)
+			translation.z = 0;
+		// Get relative rotation, the kernel returns it with a positive w
+		MQuaternion rotation(d.qx[index],d.qy[index],d.qz[index],d.qw[index]);
+		if (fabs(rotation.x) < PRECISION)
+			rotation.x = 0;
+		if (fabs(rotation.y) < PRECISION)
+			rotation.y = 0;
+		if (fabs(rotation.z) < PRECISION)
+			rotation.z = 0;
+		rotation.normalizeIt();
+		// Get relative scale
+		double scale[3] = {d.sx[index],d.sy[index],d.sz[index]};
+		if (fabs(scale[0]) < PRECISION)
+			scale[0] = 0;
+		if (fabs(scale[1]) < PRECISION)
+			scale[1] = 0;
+		if (fabs(scale[2]) < PRECISION)
+			scale[2] = 0;
+
+		// if (params.skeletonOffset) {
+		// key.tx = translation.x * params.lum - initial[x];
+
+		//store keyframe
+		keys.time[key] = time;
+		keys.tx[key] = translation.x * params.lum;
+		keys.ty[key] = translation.y * params.lum;
+		keys.tz[key] = translation.z * params.lum;
+		keys.qx[key] = rotation.x;
+		keys.qy[key] = rotation.y;
+		keys.qz[key] = rotation.z;
+		keys.qw[key] = rotation.w;
+		keys.sx[key] = scale[0];
+		keys.sy[key] = scale[1];
+		keys.sz[key] = scale[2];
+	}
+
+
+	// Restore skeleton pose
+	void Skeleton::restorePose()
+	{
+		//enable constraints, IK, etc...
+		MGlobal::executeCommand("doEnableNodeItems true all",true);
+		// save current selection list
+		MSelectionList selectionList;
+		MGlobal::getActiveSelectionList(selectionList);
+		// restore the pose on all parts of the skeleton
+		for (int i=0; i<m_roots.size(); i++)
+		{
+			MDagPath rootDag = m_joints[m_roots[i]].jointDag;
+			// select the root joint dag
+			MGlobal::selectByName(rootDag.fullPathName(),MGlobal::kReplaceList);
+			// restore pose
+			MString cmd = "dagPose -r -g -n \""+ m_restorePose;
+			cmd += "\"";
+			MGlobal::executeCommand(cmd,true);
+		}
+		//restore selection list
+		MGlobal::setActiveSelectionList(selectionList,MGlobal::kReplaceList);
+	}
+
+
+
+	// Get joint list
+	std::vector<joint>& Skeleton::getJoints()
+	{
+		return m_joints;
+	}
+
+	// Get the index of a joint from its partial path name
+	int Skeleton::getJointIndex(const MString& name) const
+	{
+		std::unordered_map<std::string,int>::const_iterator it = m_jointIndices.find(name.asChar());
+		if (it == m_jointIndices.end())
+			return -1;
+		return it->second;
+	}
+
+
+
+	// Get animations
+	std::vector<Animation>& Skeleton::getAnimations()
+	{
+		return m_animations;
+	}
+
+
+
+	// hash a real value rounded to 1e-4, so the same rig exported twice gets the same hash
+	static void hashReal(uint64_t& hash,double value)
+	{
+		int64_t rounded = (int64_t)floor(value * 10000.0 + 0.5);
+		hashBytes(hash,&rounded,sizeof(rounded));
+	}
+
+	// Get the bind pose of the bones relative to their parent, or in model space (derived) composed
+	// the way Ogre::Node does. Parents come before their children
+	void Skeleton::getBindTransforms(std::vector<Ogre::Vector3>& position,std::vector<Ogre::Quaternion>& orientation,
+		std::vector<Ogre::Vector3>& scale,bool derived)
+	{
+		int numBones = m_joints.size();
+		position.resize(numBones);
+		orientation.resize(numBones);
+		scale.resize(numBones);
+		for (int j=0; j<numBones; j++)
+		{
+			joint& jt = m_joints[j];
+			position[j] = Ogre::Vector3(jt.posx,jt.posy,jt.posz);
+			orientation[j].FromAngleAxis(Ogre::Radian(jt.angle),Ogre::Vector3(jt.axisx,jt.axisy,jt.axisz));
+			scale[j] = Ogre::Vector3(jt.scalex,jt.scaley,jt.scalez);
+			int p = jt.parentIndex;
+			if (derived && p >= 0)
+			{
+				position[j] = orientation[p] * (scale[p] * position[j]) + position[p];
+				orientation[j] = orientation[p] * orientation[j];
+				scale[j] = scale[p] * scale[j];
+			}
+		}
+	}
+
+	// Get the hash of the hierarchy and bind pose of the skeleton
+	MString Skeleton::getBindPoseHash()
+	{
+		uint64_t hash = HASH_SEED;
+		for (int i=0; i<m_joints.size(); i++)
+		{
+			joint& j = m_joints[i];
+			hashBytes(hash,j.name.asChar(),j.name.length() + 1);
+			int32_t ids[2] = {j.id,j.parentIndex};
+			hashBytes(hash,ids,sizeof(ids));
+			// the angle-axis pair is ambiguous for small rotations, use the quaternion with a positive w
+			Ogre::Quaternion q;
+			q.FromAngleAxis(Ogre::Radian(j.angle),Ogre::Vector3(j.axisx,j.axisy,j.axisz));
+			if (q.w < 0)
+				q = -q;
+			double values[10] = {j.posx,j.posy,j.posz,q.w,q.x,q.y,q.z,j.scalex,j.scaley,j.scalez};
+			for (int k=0; k<10; k++)
+				hashReal(hash,values[k]);
+		}
+		char hex[17];
+		sprintf(hex,"%016llx",(unsigned long long)hash);
+		return MString(hex);
+	}
+
+	// Get the size and hash of the contents of a file, as written next to the skeletons of the library
+	static bool getFileHash(const MString& filename,std::string& hash)
+	{
+		std::ifstream in(filename.asChar(),std::ios::binary);
+		if (!in)
+			return false;
+		std::vector<char> data((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+		uint64_t value = HASH_SEED;
+		if (data.size() > 0)
+			hashBytes(value,&data[0],data.size());
+		char text[40];
+		sprintf(text,"%llu %016llx",(unsigned long long)data.size(),(unsigned long long)value);
+		hash = text;
+		return true;
+	}
+
+	// Get the path of the skeleton in the shared skeleton library
+	MString Skeleton::getLibraryFilename(ParamList &params)
+	{
+		MString dir = params.skeletonLibraryDir;
+		int len = dir.length();
+		if (len > 0 && dir.substring(len-1,len-1) != "/" && dir.substring(len-1,len-1) != "\\")
+			dir += "/";
+		return dir + "skeleton_" + getBindPoseHash() + ".skeleton";
+	}
+
+	// Write to an OGRE binary skeleton
+	MStatus Skeleton::writeOgreBinary(ParamList &params)
+	{
+		MStatus stat;
+		// With a skeleton library the bones go to the library, where a skeleton with the same
+		// hierarchy and bind pose may already be, and the clips always go to their own files
+		bool useLibrary = params.skeletonLibraryDir != "";
+		bool splitClips = params.splitClips || useLibrary;
+		MString filename = params.skeletonFilename;
+		bool writeBones = true;
+		if (useLibrary)
+		{
+			// a skeleton in the library is only reused if it still matches the hash written with it,
+			// a missing, truncated or edited file is exported again
+			filename = getLibraryFilename(params);
+			std::string fileHash, savedHash;
+			std::ifstream hashFile((filename + ".hash").asChar());
+			bool hasFile = getFileHash(filename,fileHash);
+			if (hasFile && hashFile && std::getline(hashFile,savedHash) && savedHash == fileHash)
+			{
+				std::cout << "Using shared skeleton " << filename.asChar() << "\n";
+				writeBones = false;
+			}
+			else if (hasFile)
+			{
+				std::cout << "Warning: shared skeleton " << filename.asChar() << " doesn't match its hash file, exporting it again\n";
+			}
+			else
+			{
+				std::cout << "Adding skeleton to the library: " << filename.asChar() << "\n";
+			}
+			std::cout.flush();
+		}
+		if (writeBones)
+		{
+			// Construct skeleton
+			MString name = "exportSkeleton";
+			Ogre::SkeletonPtr pSkeleton = Ogre::SkeletonManager::getSingleton().create(name.asChar(), 
+				Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+			// Create skeleton bones
+			stat = createOgreBones(pSkeleton,params);
+			if (stat != MS::kSuccess)
+			{
+				std::cout << "Error writing skeleton binary file\n";
+				std::cout.flush();
+			}
+			// Create skeleton animation, unless the clips are written to their own files
+			if (params.exportSkelAnims && !splitClips)
+			{
+				std::vector<int> clips;
+				for (int i=0; i<m_animations.size(); i++)
+					clips.push_back(i);
+				stat = createOgreSkeletonAnimations(pSkeleton,clips,params);
+				if (stat != MS::kSuccess)
+				{
+					std::cout << "Error writing ogre skeleton animations\n";
+					std::cout.flush();
+				}
+			}
+			pSkeleton->setBindingPose();
+			// Optimise animations
+			pSkeleton->optimiseAllAnimations();
+			// Export skeleton binary
+			Ogre::SkeletonSerializer serializer;
+			serializer.exportSkeleton(pSkeleton.getPointer(),filename.asChar());
+			pSkeleton.setNull();
+			// write the hash checked before reusing the library skeleton
+			std::string fileHash;
+			if (useLibrary && getFileHash(filename,fileHash))
+			{
+				std::ofstream hashFile((filename + ".hash").asChar());
+				hashFile << fileHash << "\n";
+				if (!hashFile)
+				{
+					std::cout << "Error writing skeleton hash file " << (filename + ".hash").asChar() << "\n";
+					std::cout.flush();
+				}
+			}
+		}
+		// Write the clip skeletons
+		if (params.exportSkelAnims && splitClips)
+		{
+			stat = writeClipSkeletons(params);
+			if (stat != MS::kSuccess)
+			{
+				std::cout << "Error writing clip skeleton files\n";
+				std::cout.flush();
+			}
+		}
+		// Write the quantised animations
+		if (params.exportSkelAnims && params.exportQuantAnims)
+		{
+			stat = writeQuantAnims(params);
+			if (stat != MS::kSuccess)
+			{
+				std::cout << "Error writing quantised skeleton animations\n";
+				std::cout.flush();
+			}
+		}
+		// Bake the bone matrix textures
+		if (params.exportSkelAnims && params.exportBoneTextures)
+		{
+			stat = writeBoneTextures(params);
+			if (stat != MS::kSuccess)
+			{
+				std::cout << "Error writing bone matrix textures\n";
+				std::cout.flush();
+			}
+		}
+		// Write the level boundaries of a breadth-first ordered skeleton
+		if (params.bfsBoneOrder && !m_levelStarts.empty())
+		{
+			stat = writeLevels(params);
+			if (stat != MS::kSuccess)
+			{
+				std::cout << "Error writing skeleton levels file\n";
+				std::cout.flush();
+			}
+		}
+		// Skeleton successfully exported
+		return MS::kSuccess;
+	}
+
+	// Write the first joint and number of joints of each level to a text file
+	MStatus Skeleton::writeLevels(ParamList &params)
+	{
+		MString filename = params.skeletonFilename + ".levels";
+		std::ofstream outLevels(filename.asChar());
+		if (!outLevels)
+		{
+			std::cout << "Error opening file: " << filename.asChar() << "\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		outLevels << "levels " << m_levelStarts.size() << "\n";
+		for (int i=0; i<m_levelStarts.size(); i++)
+		{
+			int levelEnd = (i+1 < m_levelStarts.size()) ? m_levelStarts[i+1] : m_joints.size();
+			outLevels << m_levelStarts[i] << " " << levelEnd - m_levelStarts[i] << "\n";
+		}
+		outLevels.close();
+		return MS::kSuccess;
+	}
+
+	// quantise a 3 component channel against its range, returns true if the channel is constant
+	static bool quantiseChannel(const std::vector<float>* channel[3],size_t numKeys,float min[3],float extent[3],std::vector<uint16_t>& values)
+	{
+		bool constant = true;
+		for (int c=0; c<3; c++)
+		{
+			float lo = (*channel[c])[0];
+			float hi = lo;
+			for (size_t k=1; k<numKeys; k++)
+			{
+				lo = std::min(lo,(*channel[c])[k]);
+				hi = std::max(hi,(*channel[c])[k]);
+			}
+			min[c] = lo;
+			extent[c] = hi - lo;
+			if (extent[c] > 1e-6f * std::max(1.0f,std::max(fabs(lo),fabs(hi))))
+				constant = false;
+		}
+		values.clear();
+		if (constant)
+		{
+			for (int c=0; c<3; c++)
+			{
+				min[c] = (*channel[c])[0];
+				extent[c] = 0;
+			}
+			return true;
+		}
+		values.resize(3*numKeys);
+		for (size_t k=0; k<numKeys; k++)
+		{
+			for (int c=0; c<3; c++)
+				values[3*k+c] = quantiseValue((*channel[c])[k],min[c],extent[c]);
+		}
+		return false;
+	}
+
+	// quantise the keyframes of a track
+	static void quantiseTrack(const skeletonKeyframes& keys,float length,uint16_t bone,quantAnimTrack& track)
+	{
+		size_t numKeys = keys.size();
+		track.bone = bone;
+		track.flags = 0;
+		track.numKeys = numKeys;
+		track.times.resize(numKeys);
+		for (size_t k=0; k<numKeys; k++)
+			track.times[k] = quantiseValue(keys.time[k],0,length);
+		const std::vector<float>* translation[3] = {&keys.tx,&keys.ty,&keys.tz};
+		if (quantiseChannel(translation,numKeys,track.tMin,track.tExtent,track.translations))
+			track.flags |= QA_CONST_TRANSLATION;
+		const std::vector<float>* scale[3] = {&keys.sx,&keys.sy,&keys.sz};
+		if (quantiseChannel(scale,numKeys,track.sMin,track.sExtent,track.scales))
+			track.flags |= QA_CONST_SCALE;
+		// rotation is constant if all keys are the same quaternion up to sign
+		bool constant = true;
+		for (size_t k=1; k<numKeys && constant; k++)
+		{
+			float dot = keys.qx[0]*keys.qx[k] + keys.qy[0]*keys.qy[k] + keys.qz[0]*keys.qz[k] + keys.qw[0]*keys.qw[k];
+			constant = fabs(dot) >= 1 - 1e-7f;
+		}
+		if (constant)
+			track.flags |= QA_CONST_ROTATION;
+		size_t numRotations = constant ? 1 : numKeys;
+		track.rotations.resize(3*numRotations);
+		for (size_t k=0; k<numRotations; k++)
+		{
+			float q[4] = {keys.qx[k],keys.qy[k],keys.qz[k],keys.qw[k]};
+			float len = sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+			for (int i=0; i<4 && len>0; i++)
+				q[i] /= len;
+			packQuaternion(q,&track.rotations[3*k]);
+		}
+	}
+
+	// serialise a quantised track
+	static void putTrack(std::vector<unsigned char>& data,const quantAnimTrack& track)
+	{
+		putU16(data,track.bone);
+		putU16(data,track.flags);
+		putU32(data,track.numKeys);
+		for (size_t k=0; k<track.times.size(); k++)
+			putU16(data,track.times[k]);
+		for (int c=0; c<3; c++)
+			putFloat(data,track.tMin[c]);
+		if (!(track.flags & QA_CONST_TRANSLATION))
+		{
+			for (int c=0; c<3; c++)
+				putFloat(data,track.tExtent[c]);
+			for (size_t k=0; k<track.translations.size(); k++)
+				putU16(data,track.translations[k]);
+		}
+		for (size_t k=0; k<track.rotations.size(); k++)
+			putU16(data,track.rotations[k]);
+		for (int c=0; c<3; c++)
+			putFloat(data,track.sMin[c]);
+		if (!(track.flags & QA_CONST_SCALE))
+		{
+			for (int c=0; c<3; c++)
+				putFloat(data,track.sExtent[c]);
+			for (size_t k=0; k<track.scales.size(); k++)
+				putU16(data,track.scales[k]);
+		}
+	}
+
+	// Write the skeleton animations to a quantised file (see quantAnim.h for the format),
+	// then decode every keyframe back and print the maximum error of every joint
+	MStatus Skeleton::writeQuantAnims(ParamList &params)
+	{
+		MString filename = params.skeletonFilename + ".qanim";
+		std::vector<unsigned char> data;
+		data.insert(data.end(),"QANM","QANM" + 4);
+		putU32(data,QUANTANIM_VERSION);
+		putU32(data,m_joints.size());
+		putU32(data,m_animations.size());
+		std::vector<float> maxTranslationError(m_joints.size(),0);
+		std::vector<float> maxRotationError(m_joints.size(),0);
+		std::vector<float> maxScaleError(m_joints.size(),0);
+		size_t floatSize = 0;
+		for (int i=0; i<m_animations.size(); i++)
+		{
+			Animation& a = m_animations[i];
+			std::vector<quantAnimTrack> tracks;
+			std::vector<int> trackJoints;
+			for (int j=0; j<a.m_tracks.size(); j++)
+			{
+				skeletonKeyframes& keys = a.m_tracks[j].m_skeletonKeyframes;
+				int jointIdx = getJointIndex(a.m_tracks[j].m_bone);
+				if (keys.size() == 0 || jointIdx < 0)
+					continue;
+				quantAnimTrack track;
+				quantiseTrack(keys,a.m_length,m_joints[jointIdx].id,track);
+				tracks.push_back(track);
+				trackJoints.push_back(jointIdx);
+				floatSize += keys.size() * 11 * sizeof(float);
+				// measure the reconstruction error at the original keyframes
+				for (int k=0; k<keys.size(); k++)
+				{
+					float t[3], q[4], s[3];
+					QuantAnimDecoder::sampleTrack(track,a.m_length,keys.time[k],t,q,s);
+					float dx = t[0] - keys.tx[k], dy = t[1] - keys.ty[k], dz = t[2] - keys.tz[k];
+					// rotation angle between the quaternions, from their distance as acos loses precision near 1
+					float keyq[4] = {keys.qx[k],keys.qy[k],keys.qz[k],keys.qw[k]};
+					float sign = (q[0]*keyq[0] + q[1]*keyq[1] + q[2]*keyq[2] + q[3]*keyq[3]) < 0 ? -1.0f : 1.0f;
+					float dist = 0;
+					for (int c=0; c<4; c++)
+						dist += (q[c] - sign*keyq[c]) * (q[c] - sign*keyq[c]);
+					float angle = 4 * asin(std::min(1.0f,sqrt(dist) * 0.5f)) * 180.0f / Ogre::Math::PI;
+					float ds = std::max(fabs(s[0] - keys.sx[k]),std::max(fabs(s[1] - keys.sy[k]),fabs(s[2] - keys.sz[k])));
+					maxTranslationError[jointIdx] = std::max(maxTranslationError[jointIdx],(float)sqrt(dx*dx + dy*dy + dz*dz));
+					maxRotationError[jointIdx] = std::max(maxRotationError[jointIdx],angle);
+					maxScaleError[jointIdx] = std::max(maxScaleError[jointIdx],ds);
+				}
+			}
+			putU16(data,a.m_name.length());
+			data.insert(data.end(),a.m_name.asChar(),a.m_name.asChar() + a.m_name.length());
+			putFloat(data,a.m_length);
+			putU32(data,tracks.size());
+			for (int j=0; j<tracks.size(); j++)
+				putTrack(data,tracks[j]);
+		}
+		// write the file
+		std::ofstream outQuant(filename.asChar(),std::ios::binary);
+		if (!outQuant)
+		{
+			std::cout << "Error opening file: " << filename.asChar() << "\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		outQuant.write((const char*)&data[0],data.size());
+		outQuant.close();
+		std::cout << "Quantised skeleton animations: " << data.size() << " bytes (" << floatSize << " bytes of float keyframes)\n";
+		std::cout << "Maximum reconstruction error per joint (translation, rotation in degrees, scale):\n";
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			std::cout << "\t" << m_joints[j].name.asChar() << ": " << maxTranslationError[j] << ", "
+				<< maxRotationError[j] << ", " << maxScaleError[j] << "\n";
+		}
+		std::cout.flush();
+		return MS::kSuccess;
+	}
+
+	/***** bone matrix textures *****/
+	// convert a float to a half float, rounding to nearest even
+	static uint16_t floatToHalf(float f)
+	{
+		uint32_t bits;
+		memcpy(&bits,&f,4);
+		uint16_t sign = (bits >> 16) & 0x8000;
+		int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+		uint32_t mantissa = bits & 0x7fffff;
+		// infinity and nan
+		if (((bits >> 23) & 0xff) == 0xff)
+			return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+		// overflow
+		if (exponent >= 31)
+			return sign | 0x7c00;
+		// denormals
+		if (exponent <= 0)
+		{
+			if (exponent < -10)
+				return sign;
+			mantissa |= 0x800000;
+			int shift = 14 - exponent;
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if (rest > halfway || (rest == halfway && (half & 1)))
+				half++;
+			return sign | half;
+		}
+		// a carry from the mantissa correctly moves to the exponent
+		uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1fff;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+			half++;
+		return sign | half;
+	}
+
+	// write an uncompressed floating point RGBA texture to a DDS file (legacy header, D3DFMT fourcc)
+	static bool writeDDS(std::ofstream& out,int width,int height,bool half)
+	{
+		uint32_t header[32] = {0};
+		header[0] = 0x20534444;					//"DDS "
+		header[1] = 124;						//header size
+		header[2] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000;	//caps, height, width, pitch, pixel format
+		header[3] = height;
+		header[4] = width;
+		header[5] = width * 4 * (half ? 2 : 4);	//pitch
+		header[19] = 32;						//pixel format size
+		header[20] = 0x4;						//fourcc
+		header[21] = half ? 113 : 116;			//D3DFMT_A16B16G16R16F or D3DFMT_A32B32G32R32F
+		header[27] = 0x1000;					//texture
+		std::vector<unsigned char> data;
+		for (int i=0; i<32; i++)
+			putU32(data,header[i]);
+		out.write((const char*)&data[0],data.size());
+		return out.good();
+	}
+
+	// escape a string for a json file
+	static std::string jsonString(const char* s)
+	{
+		std::string out = "\"";
+		for (; *s; s++)
+		{
+			if (*s == '"' || *s == '\\')
+				out += '\\';
+			out += *s;
+		}
+		return out + "\"";
+	}
+
+	// Bake the skinning matrix of every bone to a texture, for every frame of every clip.
+	// Matrices are built the way Ogre builds the bone offset transforms for skinning, so the
+	// texture can replace the skeleton at runtime. Each bone uses 3 RGBA texels holding the
+	// rows of its 3x4 matrix, each frame is a texture row
+	MStatus Skeleton::writeBoneTextures(ParamList &params)
+	{
+		if (params.boneTexRate <= 0)
+		{
+			std::cout << "Invalid bone texture frame rate: " << params.boneTexRate << "\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		int numBones = m_joints.size();
+		// bind pose of the bones, relative to their parent and in model space
+		std::vector<Ogre::Vector3> bindPosition, bindScale;
+		std::vector<Ogre::Quaternion> bindOrientation;
+		std::vector<Ogre::Vector3> bindDerivedPosition, bindDerivedScale;
+		std::vector<Ogre::Quaternion> bindDerivedOrientation;
+		getBindTransforms(bindPosition,bindOrientation,bindScale,false);
+		getBindTransforms(bindDerivedPosition,bindDerivedOrientation,bindDerivedScale,true);
+		// list the frames of every clip
+		std::vector<int> frameClips;
+		std::vector<float> frameTimes;
+		std::vector<int> firstFrames;
+		for (int i=0; i<m_animations.size(); i++)
+		{
+			firstFrames.push_back(frameTimes.size());
+			int numFrames = (int)floor(m_animations[i].m_length * params.boneTexRate + 0.5f) + 1;
+			for (int f=0; f<numFrames; f++)
+			{
+				frameClips.push_back(i);
+				frameTimes.push_back(std::min(f / params.boneTexRate,m_animations[i].m_length));
+			}
+		}
+		int width = 3 * numBones;
+		int height = frameTimes.size();
+		if (width > 16384 || height > 16384)
+		{
+			std::cout << "Warning: bone matrix texture is " << width << "x" << height << ", larger than most GPUs support\n";
+			std::cout.flush();
+		}
+		// find the keyframes of every joint in every clip, track names are Maya strings
+		// so they are resolved here rather than on the worker threads
+		std::vector<std::vector<const skeletonKeyframes*> > clipKeys(m_animations.size());
+		for (int i=0; i<m_animations.size(); i++)
+		{
+			Animation& a = m_animations[i];
+			clipKeys[i].assign(numBones,(const skeletonKeyframes*)0);
+			for (int j=0; j<a.m_tracks.size(); j++)
+			{
+				int jointIdx = getJointIndex(a.m_tracks[j].m_bone);
+				if (jointIdx >= 0 && a.m_tracks[j].m_skeletonKeyframes.size() > 0)
+					clipKeys[i][jointIdx] = &a.m_tracks[j].m_skeletonKeyframes;
+			}
+		}
+		// bake the frames on the worker threads, it's only Ogre math
+		std::vector<float> texels(width * height * 4);
+		WorkerPool workers(params.numThreads);
+		workers.parallelFor(frameTimes.size(),[&](size_t f)
+		{
+			const std::vector<const skeletonKeyframes*>& jointKeys = clipKeys[frameClips[f]];
+			std::vector<Ogre::Vector3> position(numBones), scale(numBones);
+			std::vector<Ogre::Quaternion> orientation(numBones);
+			for (int j=0; j<numBones; j++)
+			{
+				Ogre::Vector3 translation = Ogre::Vector3::ZERO, keyScale = Ogre::Vector3::UNIT_SCALE;
+				Ogre::Quaternion rotation = Ogre::Quaternion::IDENTITY;
+				if (jointKeys[j])
+					sampleKeyframes(*jointKeys[j],frameTimes[f],translation,rotation,keyScale);
+				// keyframes are relative to the bind pose
+				position[j] = bindPosition[j] + translation;
+				orientation[j] = bindOrientation[j] * rotation;
+				scale[j] = bindScale[j] * keyScale;
+				int p = m_joints[j].parentIndex;
+				if (p >= 0)
+				{
+					position[j] = orientation[p] * (scale[p] * position[j]) + position[p];
+					orientation[j] = orientation[p] * orientation[j];
+					scale[j] = scale[p] * scale[j];
+				}
+				// offset from the bind pose, as Ogre::Bone::_getOffsetTransform
+				Ogre::Vector3 locScale = scale[j] / bindDerivedScale[j];
+				Ogre::Quaternion locRotate = orientation[j] * bindDerivedOrientation[j].Inverse();
+				Ogre::Vector3 locTranslate = position[j] + locRotate * (locScale * -bindDerivedPosition[j]);
+				Ogre::Matrix4 m;
+				m.makeTransform(locTranslate,locScale,locRotate);
+				float* texel = &texels[(f * width + 3 * j) * 4];
+				for (int r=0; r<3; r++)
+				{
+					for (int c=0; c<4; c++)
+						texel[4*r+c] = m[r][c];
+				}
+			}
+		});
+		// write the texture
+		MString texFilename = params.skeletonFilename + (params.boneTexDDS ? ".bonetex.dds" : ".bonetex.raw");
+		std::ofstream outTex(texFilename.asChar(),std::ios::binary);
+		if (!outTex)
+		{
+			std::cout << "Error opening file: " << texFilename.asChar() << "\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		if (params.boneTexDDS)
+			writeDDS(outTex,width,height,params.boneTexHalf);
+		std::vector<unsigned char> data;
+		for (int i=0; i<texels.size(); i++)
+		{
+			if (params.boneTexHalf)
+			{
+				putU16(data,floatToHalf(texels[i]));
+			}
+			else
+			{
+				putFloat(data,texels[i]);
+			}
+		}
+		if (!data.empty())
+			outTex.write((const char*)&data[0],data.size());
+		outTex.close();
+		// write the index of the clip frames
+		MString indexFilename = params.skeletonFilename + ".bonetex.json";
+		std::ofstream outIndex(indexFilename.asChar());
+		if (!outIndex)
+		{
+			std::cout << "Error opening file: " << indexFilename.asChar() << "\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		int slash = std::max(texFilename.rindex('/'),texFilename.rindex('\\'));
+		MString texName = texFilename.substring(slash+1,texFilename.length()-1);
+		outIndex << "{\n";
+		outIndex << "\t\"texture\": " << jsonString(texName.asChar()) << ",\n";
+		outIndex << "\t\"format\": \"" << (params.boneTexHalf ? "rgba16f" : "rgba32f") << "\",\n";
+		outIndex << "\t\"width\": " << width << ",\n";
+		outIndex << "\t\"height\": " << height << ",\n";
+		outIndex << "\t\"bones\": " << numBones << ",\n";
+		outIndex << "\t\"texelsPerBone\": 3,\n";
+		outIndex << "\t\"fps\": " << params.boneTexRate << ",\n";
+		outIndex << "\t\"clips\": [";
+		for (int i=0; i<m_animations.size(); i++)
+		{
+			int lastFrame = (i+1 < firstFrames.size()) ? firstFrames[i+1] : height;
+			outIndex << (i > 0 ? ",\n" : "\n") << "\t\t{ \"name\": " << jsonString(m_animations[i].m_name.asChar())
+				<< ", \"length\": " << m_animations[i].m_length << ", \"firstFrame\": " << firstFrames[i]
+				<< ", \"frameCount\": " << lastFrame - firstFrames[i] << " }";
+		}
+		outIndex << "\n\t]\n}\n";
+		outIndex.close();
+		std::cout << "Baked " << height << " frames of " << numBones << " bones to " << texFilename.asChar() << "\n";
+		std::cout.flush();
+		return MS::kSuccess;
+	}
+
+	// Write joints to an Ogre skeleton
+	MStatus Skeleton::createOgreBones(Ogre::SkeletonPtr pSkeleton,ParamList& params)
+	{
+		// Create the bones
+		for (int i=0; i<m_joints.size(); i++)
+		{
+			joint* j = &m_joints[i];
+			// Create a new bone
+			Ogre::String jointName = j->name.asChar();
+			int jointId = j->id;
+			Ogre::Bone* pBone = pSkeleton->createBone(jointName, jointId);
+			// Set bone position (relative to it's parent)
+			pBone->setPosition(j->posx,j->posy,j->posz);
+			// Set bone orientation (relative to it's parent)
+			Ogre::Quaternion orient;
+			orient.FromAngleAxis(Ogre::Radian(j->angle),Ogre::Vector3(j->axisx,j->axisy,j->axisz));
+			pBone->setOrientation(orient);
+			// Set bone scale (relative to it's parent)
+			pBone->setScale(j->scalex,j->scaley,j->scalez);
+		}
+		// Create the hierarchy
+		for (int i=0; i<m_joints.size(); i++)
+		{
+			joint* j = &m_joints[i];
+			int parentIdx = j->parentIndex;
+			if (parentIdx >= 0)
+			{
+				// Get the parent joint
+				joint* parentJoint = &m_joints[parentIdx];
+				unsigned short parentId = m_joints[parentIdx].id;
+				Ogre::String parentName = parentJoint->name.asChar();
+				Ogre::Bone* pParent = pSkeleton->getBone(parentName);
+				// Get current joint from skeleton
+				unsigned short jointId = j->id;
+				Ogre::String jointName = j->name.asChar();
+				Ogre::Bone* pBone = pSkeleton->getBone(jointName);
+				// Place current bone in the parent's child list
+				pParent->addChild(pBone);
+			}
+		}
+		return MS::kSuccess;
+	}
+
+
+	// Create an Ogre animation from the keyframes of its tracks, trackBones holds the bone handle
+	// of every track. It only uses Ogre, so it's safe to run on a worker thread
+	static void createOgreAnimation(Ogre::Skeleton* pSkeleton,const std::string& name,float length,
+		const std::vector<Track>& tracks,const std::vector<int>& trackBones)
+	{
+		// Create a new animation
+		Ogre::Animation* pAnimation = pSkeleton->createAnimation(name,length);
+		// Create tracks for current animation
+		for (int j=0; j<tracks.size(); j++)
+		{
+			if (trackBones[j] < 0)
+				continue;
+			// Create a new track
+			Ogre::NodeAnimationTrack* pTrack = pAnimation->createNodeTrack(j,pSkeleton->getBone((unsigned short)trackBones[j]));
+			// Create keyframes for current track
+			const skeletonKeyframes& keys = tracks[j].m_skeletonKeyframes;
+			for (int k=0; k<keys.size(); k++)
+			{
+				// Create a new keyframe
+				Ogre::TransformKeyFrame* pKeyframe = pTrack->createNodeKeyFrame(keys.time[k]);
+				// Set translation
+				pKeyframe->setTranslate(Ogre::Vector3(keys.tx[k],keys.ty[k],keys.tz[k]));
+				// Set rotation
+				pKeyframe->setRotation(Ogre::Quaternion(keys.qw[k],keys.qx[k],keys.qy[k],keys.qz[k]));
+				// Set scale
+				pKeyframe->setScale(Ogre::Vector3(keys.sx[k],keys.sy[k],keys.sz[k]));
+			}
+		}
+	}
+
+	// Get the bone handle of every track of a clip, -1 for tracks of unknown joints
+	void Skeleton::getTrackBones(int clip,std::vector<int>& trackBones)
+	{
+		std::vector<Track>& tracks = m_animations[clip].m_tracks;
+		trackBones.resize(tracks.size());
+		for (int j=0; j<tracks.size(); j++)
+		{
+			int jointIdx = getJointIndex(tracks[j].m_bone);
+			trackBones[j] = jointIdx >= 0 ? m_joints[jointIdx].id : -1;
+		}
+	}
+
+	// Write skeleton animations to an Ogre skeleton
+	MStatus Skeleton::createOgreSkeletonAnimations(Ogre::SkeletonPtr pSkeleton,const std::vector<int>& clips,ParamList& params)
+	{
+		// Read loaded skeleton animations
+		for (int i=0; i<clips.size(); i++)
+		{
+			Animation& a = m_animations[clips[i]];
+			std::vector<int> trackBones;
+			getTrackBones(clips[i],trackBones);
+			createOgreAnimation(pSkeleton.getPointer(),a.m_name.asChar(),a.m_length,a.m_tracks,trackBones);
+		}
+		return MS::kSuccess;
+	}
+
+	// Write the skeleton animations to one skeleton file per clip or group of clips. Each file
+	// holds a copy of the bones, so the runtime can load it on demand and attach it to the main
+	// skeleton with Ogre::Skeleton::addLinkedSkeletonAnimationSource
+	MStatus Skeleton::writeClipSkeletons(ParamList &params)
+	{
+		// group the clips, clips that don't match any group get their own file
+		std::vector<MString> groupNames;
+		std::vector<std::vector<int> > groupClips;
+		for (int i=0; i<m_animations.size(); i++)
+		{
+			MString groupName = m_animations[i].m_name;
+			for (unsigned int g=0; g<params.clipGroupNames.length(); g++)
+			{
+				if (matchesPattern(params.clipGroupPatterns[g].asChar(),m_animations[i].m_name.asChar()))
+				{
+					groupName = params.clipGroupNames[g];
+					break;
+				}
+			}
+			int group = 0;
+			while (group < groupNames.size() && groupNames[group] != groupName)
+				group++;
+			if (group == groupNames.size())
+			{
+				groupNames.push_back(groupName);
+				groupClips.push_back(std::vector<int>());
+			}
+			groupClips[group].push_back(i);
+		}
+		// clip files are named after the skeleton file
+		MString baseName = params.skeletonFilename;
+		int len = baseName.length();
+		if (len > 9 && baseName.substring(len-9,len-1) == ".skeleton")
+			baseName = baseName.substring(0,len-10);
+		// create the skeletons and their bones here, the skeleton manager and Maya strings can't be used
+		// on the worker threads, and collect what the workers need to create the animations
+		std::vector<Ogre::SkeletonPtr> skeletons(groupNames.size());
+		std::vector<std::string> filenames(groupNames.size());
+		std::vector<std::vector<std::string> > animNames(groupNames.size());
+		std::vector<std::vector<std::vector<int> > > trackBones(groupNames.size());
+		for (int g=0; g<groupNames.size(); g++)
+		{
+			MString name = MString("exportSkeleton_") + groupNames[g];
+			skeletons[g] = Ogre::SkeletonManager::getSingleton().create(name.asChar(),
+				Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+			if (createOgreBones(skeletons[g],params) != MS::kSuccess)
+			{
+				std::cout << "Error creating the bones of clip skeleton " << groupNames[g].asChar() << "\n";
+				std::cout.flush();
+			}
+			filenames[g] = (baseName + "_" + groupNames[g] + ".skeleton").asChar();
+			animNames[g].resize(groupClips[g].size());
+			trackBones[g].resize(groupClips[g].size());
+			for (int i=0; i<groupClips[g].size(); i++)
+			{
+				animNames[g][i] = m_animations[groupClips[g][i]].m_name.asChar();
+				getTrackBones(groupClips[g][i],trackBones[g][i]);
+			}
+		}
+		// create the animations and write the files on the worker threads. The serializer writes
+		// to the Ogre log, which isn't thread safe in every Ogre build, so only the writing itself
+		// is serialised
+		std::mutex serializerMutex;
+		WorkerPool workers(params.numThreads);
+		workers.parallelFor(groupNames.size(),[&](size_t g)
+		{
+			Ogre::Skeleton* pSkeleton = skeletons[g].getPointer();
+			for (int i=0; i<groupClips[g].size(); i++)
+			{
+				Animation& a = m_animations[groupClips[g][i]];
+				createOgreAnimation(pSkeleton,animNames[g][i],a.m_length,a.m_tracks,trackBones[g][i]);
+			}
+			pSkeleton->setBindingPose();
+			pSkeleton->optimiseAllAnimations();
+			std::lock_guard<std::mutex> lock(serializerMutex);
+			Ogre::SkeletonSerializer serializer;
+			serializer.exportSkeleton(pSkeleton,filenames[g]);
+		});
+		for (int g=0; g<groupNames.size(); g++)
+		{
+			std::cout << "Wrote clip skeleton " << filenames[g] << " (" << groupClips[g].size() << " clips)\n";
+			skeletons[g].setNull();
+		}
+		std::cout.flush();
+		return MS::kSuccess;
+	}
+	
+
+	/***** animation cache *****/
+	const uint32_t ANIMCACHE_VERSION = 1;
+
+	// hash the keys of an animation curve that affect a time range: the keys in the range
+	// and the ones just outside of it, or all keys if the curve repeats outside of its keys.
+	// Driven key curves are not keyed on time, all their keys are hashed
+	static void hashAnimCurve(uint64_t& hash,const MObject& curve,float start,float stop)
+	{
+		MFnAnimCurve curveFn(curve);
+		hashBytes(hash,curveFn.name().asChar(),curveFn.name().length() + 1);
+		MFnAnimCurve::InfinityType preInfinity = curveFn.preInfinityType();
+		MFnAnimCurve::InfinityType postInfinity = curveFn.postInfinityType();
+		int32_t curveInfo[4] = {curveFn.animCurveType(),preInfinity,postInfinity,curveFn.isWeighted()};
+		hashBytes(hash,curveInfo,sizeof(curveInfo));
+		bool timeInput = curveFn.isTimeInput();
+		bool allKeys = !timeInput || (preInfinity != MFnAnimCurve::kConstant && preInfinity != MFnAnimCurve::kLinear) ||
+			(postInfinity != MFnAnimCurve::kConstant && postInfinity != MFnAnimCurve::kLinear);
+		unsigned int numKeys = curveFn.numKeys();
+		for (unsigned int k=0; k<numKeys; k++)
+		{
+			if (!allKeys && k+1 < numKeys && curveFn.time(k+1).as(MTime::kSeconds) < start)
+				continue;
+			if (!allKeys && k > 0 && curveFn.time(k-1).as(MTime::kSeconds) > stop)
+				break;
+			hashReal(hash,timeInput ? curveFn.time(k).as(MTime::kSeconds) : curveFn.unitlessInput(k));
+			hashReal(hash,curveFn.value(k));
+			int32_t tangentTypes[2] = {curveFn.inTangentType(k),curveFn.outTangentType(k)};
+			hashBytes(hash,tangentTypes,sizeof(tangentTypes));
+			float x, y;
+			curveFn.getTangent(k,x,y,true);
+			hashReal(hash,x);
+			hashReal(hash,y);
+			curveFn.getTangent(k,x,y,false);
+			hashReal(hash,x);
+			hashReal(hash,y);
+		}
+	}
+
+	// Get the fingerprint of a clip, from the clip settings, the export settings that change the
+	// sampled keyframes, the skeleton hierarchy and bind pose and the keys of the animation curves,
+	// driven keys included
+	uint64_t Skeleton::getClipFingerprint(const clipInfo& ci,const MObjectArray& curves,ParamList& params)
+	{
+		uint64_t hash = HASH_SEED;
+		hashBytes(hash,&ANIMCACHE_VERSION,sizeof(ANIMCACHE_VERSION));
+		// clip and export settings
+		hashReal(hash,ci.start);
+		hashReal(hash,ci.stop);
+		hashReal(hash,ci.rate);
+		hashReal(hash,params.lum);
+		hashReal(hash,params.autoRateTolerance);
+		int32_t flags[2] = {params.exportWorldCoords,params.neutralPoseType};
+		hashBytes(hash,flags,sizeof(flags));
+		// skeleton
+		MString rigHash = getBindPoseHash();
+		hashBytes(hash,rigHash.asChar(),rigHash.length());
+		for (int j=0; j<m_joints.size(); j++)
+		{
+			int32_t evalLocal = m_joints[j].evalLocal;
+			hashBytes(hash,&evalLocal,sizeof(evalLocal));
+		}
+		// animation curves
+		for (unsigned int i=0; i<curves.length(); i++)
+			hashAnimCurve(hash,curves[i],ci.start,ci.stop);
+		return hash;
+	}
+
+	// read little endian values from a byte buffer, return false past the end of the data
+	static bool getU32(const std::vector<char>& data,size_t& pos,uint32_t& v)
+	{
+		if (pos + 4 > data.size())
+			return false;
+		v = 0;
+		for (int i=0; i<4; i++)
+			v |= (uint32_t)(unsigned char)data[pos+i] << (8*i);
+		pos += 4;
+		return true;
+	}
+
+	static bool getFloat(const std::vector<char>& data,size_t& pos,float& v)
+	{
+		uint32_t bits;
+		if (!getU32(data,pos,bits))
+			return false;
+		memcpy(&v,&bits,4);
+		return true;
+	}
+
+	static bool getString(const std::vector<char>& data,size_t& pos,MString& s)
+	{
+		uint32_t length;
+		if (!getU32(data,pos,length) || length > data.size() - pos)
+			return false;
+		s = MString(&data[0] + pos,length);
+		pos += length;
+		return true;
+	}
+
+	// Load the clips of the animation cache file
+	void Skeleton::loadAnimCache(ParamList& params)
+	{
+		m_cachedAnims.clear();
+		m_cachedFingerprints.clear();
+		std::ifstream in(params.animCacheFile.asChar(),std::ios::binary);
+		if (!in)
+			return;
+		std::vector<char> data((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+		size_t pos = 4;
+		uint32_t version, numClips;
+		if (data.size() < 4 || memcmp(&data[0],"OMAC",4) != 0 || !getU32(data,pos,version) ||
+			version != ANIMCACHE_VERSION || !getU32(data,pos,numClips))
+		{
+			std::cout << "Ignoring invalid animation cache " << params.animCacheFile.asChar() << "\n";
+			std::cout.flush();
+			return;
+		}
+		for (uint32_t i=0; i<numClips; i++)
+		{
+			uint32_t fingerprint[2], numTracks;
+			Animation a;
+			if (!getU32(data,pos,fingerprint[0]) || !getU32(data,pos,fingerprint[1]) || !getString(data,pos,a.m_name) ||
+				!getFloat(data,pos,a.m_length) || !getU32(data,pos,numTracks))
+				break;
+			bool valid = true;
+			for (uint32_t j=0; j<numTracks && valid; j++)
+			{
+				Track t;
+				t.m_type = TT_SKELETON;
+				uint32_t numKeys;
+				// compare the key count with the remaining data, the byte count could overflow
+				valid = getString(data,pos,t.m_bone) && getU32(data,pos,numKeys) && numKeys <= (data.size() - pos) / (11 * 4);
+				if (!valid)
+					break;
+				skeletonKeyframes& keys = t.m_skeletonKeyframes;
+				keys.resize(numKeys);
+				std::vector<float>* channels[11] = {&keys.time,&keys.tx,&keys.ty,&keys.tz,&keys.qx,&keys.qy,&keys.qz,&keys.qw,&keys.sx,&keys.sy,&keys.sz};
+				for (int c=0; c<11; c++)
+				{
+					for (uint32_t k=0; k<numKeys; k++)
+						getFloat(data,pos,(*channels[c])[k]);
+				}
+				a.addTrack(t);
+			}
+			if (!valid)
+				break;
+			m_cachedAnims.push_back(a);
+			m_cachedFingerprints.push_back((uint64_t)fingerprint[0] | ((uint64_t)fingerprint[1] << 32));
+		}
+	}
+
+	// Save the sampled clips to the animation cache file, with the cached clips that were not exported
+	void Skeleton::saveAnimCache(ParamList& params)
+	{
+		std::vector<Animation*> anims;
+		std::vector<uint64_t> fingerprints;
+		for (int i=0; i<m_clipFingerprints.size(); i++)
+		{
+			anims.push_back(&m_animations[i]);
+			fingerprints.push_back(m_clipFingerprints[i]);
+		}
+		for (int i=0; i<m_cachedAnims.size(); i++)
+		{
+			bool exported = false;
+			for (int j=0; j<m_clipFingerprints.size() && !exported; j++)
+				exported = m_animations[j].m_name == m_cachedAnims[i].m_name;
+			if (!exported)
+			{
+				anims.push_back(&m_cachedAnims[i]);
+				fingerprints.push_back(m_cachedFingerprints[i]);
+			}
+		}
+		std::vector<unsigned char> data;
+		data.insert(data.end(),"OMAC","OMAC" + 4);
+		putU32(data,ANIMCACHE_VERSION);
+		putU32(data,anims.size());
+		for (int i=0; i<anims.size(); i++)
+		{
+			Animation& a = *anims[i];
+			putU32(data,fingerprints[i] & 0xffffffff);
+			putU32(data,fingerprints[i] >> 32);
+			putU32(data,a.m_name.length());
+			data.insert(data.end(),a.m_name.asChar(),a.m_name.asChar() + a.m_name.length());
+			putFloat(data,a.m_length);
+			putU32(data,a.m_tracks.size());
+			for (int j=0; j<a.m_tracks.size(); j++)
+			{
+				Track& t = a.m_tracks[j];
+				putU32(data,t.m_bone.length());
+				data.insert(data.end(),t.m_bone.asChar(),t.m_bone.asChar() + t.m_bone.length());
+				skeletonKeyframes& keys = t.m_skeletonKeyframes;
+				putU32(data,keys.size());
+				std::vector<float>* channels[11] = {&keys.time,&keys.tx,&keys.ty,&keys.tz,&keys.qx,&keys.qy,&keys.qz,&keys.qw,&keys.sx,&keys.sy,&keys.sz};
+				for (int c=0; c<11; c++)
+				{
+					for (int k=0; k<keys.size(); k++)
+						putFloat(data,(*channels[c])[k]);
+				}
+			}
+		}
+		std::ofstream out(params.animCacheFile.asChar(),std::ios::binary);
+		if (!out)
+		{
+			std::cout << "Error opening file: " << params.animCacheFile.asChar() << "\n";
+			std::cout.flush();
+			return;
+		}
+		out.write((const char*)&data[0],data.size());
+		out.close();
+	}
+
 
 };	//end namespace
\ No newline at end of file
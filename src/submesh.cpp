@@ -81,9 +81,14 @@ namespace OgreMayaExporter
 		m_indices.clear();
 		m_vertices.clear();
 		m_faces.clear();
+		m_sharedFaces.clear();
 		m_uvsets.clear();
 		m_use32bitIndexes = false;
+		m_exportColours = false;
+		m_buildTangents = false;
 		m_pBlendShape = NULL;
+		m_pOgreSubmesh = NULL;
+		m_ogreBoneAssignments.clear();
 	}
 
 	// return number of triangles composing the mesh
@@ -105,6 +110,24 @@ namespace OgreMayaExporter
 	}
 
 /***** load data *****/
+	// Load faces indexing the shared vertex buffer, the faces vertex indices are local to the maya mesh
+	void Submesh::loadSharedFaces(std::vector<face>& faces,long vertexOffset,bool opposite)
+	{
+		m_sharedFaces.clear();
+		for (int i=0; i<faces.size(); i++)
+		{
+			face newFace;
+			for (int j=0; j<3; j++)
+			{
+				if (opposite)	// reverse order of face vertices to get correct culling
+					newFace.v[2-j] = vertexOffset + faces[i].v[j];
+				else
+					newFace.v[j] = vertexOffset + faces[i].v[j];
+			}
+			m_sharedFaces.push_back(newFace);
+		}
+	}
+
 	MStatus Submesh::loadMaterial(MObject& shader,MStringArray& uvsets,ParamList& params)
 	{
 		MPlug plug;
@@ -179,8 +202,11 @@ namespace OgreMayaExporter
 		MFnMesh mesh(dag);
 		std::cout << "Loading submesh : " << m_name.asChar() << "...";
 		std::cout.flush();
+		//vertex colours and tangents may be dropped later by the attribute usage analysis
+		m_exportColours = params.exportVertCol;
+		m_buildTangents = params.buildTangents;
 		//save uvsets info
-		for (int i=m_uvsets.size(); i<texcoordsets.length(); i++)
+		for (int i=m_uvsets.size(); i<texcoordsets.length() && (params.vertexAttributes & VA_TEXCOORD); i++)
 		{
 			uvset uv;
 			uv.size = 2;
@@ -257,26 +283,29 @@ namespace OgreMayaExporter
 			v.y = point.y;
 			v.z = point.z;
 			// save vertex normal
-			MFloatVector normal = normals[vInfo.normalIdx];
-			if (fabs(normal.x) < PRECISION)
-				normal.x = 0;
-			if (fabs(normal.y) < PRECISION)
-				normal.y = 0;
-			if (fabs(normal.z) < PRECISION)
-				normal.z = 0;
-			if (opposite)
+			if (vInfo.normalIdx >= 0)
 			{
-				v.n.x = -normal.x;
-				v.n.y = -normal.y;
-				v.n.z = -normal.z;
-			}
-			else
-			{
-				v.n.x = normal.x;
-				v.n.y = normal.y;
-				v.n.z = normal.z;
+				MFloatVector normal = normals[vInfo.normalIdx];
+				if (fabs(normal.x) < PRECISION)
+					normal.x = 0;
+				if (fabs(normal.y) < PRECISION)
+					normal.y = 0;
+				if (fabs(normal.z) < PRECISION)
+					normal.z = 0;
+				if (opposite)
+				{
+					v.n.x = -normal.x;
+					v.n.y = -normal.y;
+					v.n.z = -normal.z;
+				}
+				else
+				{
+					v.n.x = normal.x;
+					v.n.y = normal.y;
+					v.n.z = normal.z;
+				}
+				v.n.normalize();
 			}
-			v.n.normalize();
 			// save vertex color
 			v.r = vInfo.r;
 			v.g = vInfo.g;
@@ -382,16 +411,16 @@ namespace OgreMayaExporter
 
 
 /***** Export data *****/
-	// Write submesh data to an Ogre compatible mesh
+	// Create the Ogre submesh and allocate its buffers
 	MStatus Submesh::createOgreSubmesh(Ogre::MeshPtr pMesh,const ParamList& params)
 	{
-		MStatus stat;
 		// Create a new submesh
 		Ogre::SubMesh* pSubmesh;
 		if (m_name != "")
 			pSubmesh = pMesh->createSubMesh(m_name.asChar());
 		else
 			pSubmesh = pMesh->createSubMesh();
+		m_pOgreSubmesh = pSubmesh;
 		// Set material
         pSubmesh->setMaterialName(m_pMaterial->name().asChar());
         // Set use shared geometry flag
@@ -413,31 +442,6 @@ namespace OgreMayaExporter
 				use32BitIndexes ? Ogre::HardwareIndexBuffer::IT_32BIT : Ogre::HardwareIndexBuffer::IT_16BIT,
 				pSubmesh->indexData->indexCount,
 				Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-		// Fill the index buffer with faces data
-		if (use32BitIndexes)
-        {
-			Ogre::uint32* pIdx = static_cast<Ogre::uint32*>(
-				pSubmesh->indexData->indexBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
-			for (int i=0; i<m_faces.size(); i++)
-			{
-				*pIdx++ = static_cast<Ogre::uint32>(m_faces[i].v[0]);
-				*pIdx++ = static_cast<Ogre::uint32>(m_faces[i].v[1]);
-				*pIdx++ = static_cast<Ogre::uint32>(m_faces[i].v[2]);
-			}
-			pSubmesh->indexData->indexBuffer->unlock();
-        }
-        else
-        {
-            Ogre::uint16* pIdx = static_cast<Ogre::uint16*>(
-				pSubmesh->indexData->indexBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
-            for (int i=0; i<m_faces.size(); i++)
-			{
-				*pIdx++ = static_cast<Ogre::uint16>(m_faces[i].v[0]);
-				*pIdx++ = static_cast<Ogre::uint16>(m_faces[i].v[1]);
-				*pIdx++ = static_cast<Ogre::uint16>(m_faces[i].v[2]);
-			}
-			pSubmesh->indexData->indexBuffer->unlock();
-		}
 		// Define vertex declaration (only if we're not using shared geometry)
 		if(!params.useSharedGeom)
 		{
@@ -454,7 +458,7 @@ namespace OgreMayaExporter
 				offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
 			}
 			// Add vertex colour
-			if(params.exportVertCol)
+			if(m_exportColours)
 			{
 				pDecl->addElement(buf, offset, Ogre::VET_COLOUR, Ogre::VES_DIFFUSE);
 				offset += Ogre::VertexElement::getTypeSize(Ogre::VET_COLOUR);
@@ -466,69 +470,156 @@ namespace OgreMayaExporter
 				pDecl->addElement(buf, offset, uvType, Ogre::VES_TEXTURE_COORDINATES, i);
 				offset += Ogre::VertexElement::getTypeSize(uvType);
 			}
+			// Switch to the optimal vertex declaration before creating the buffers, so they
+			// can be filled directly in their final layout instead of being reorganised
 			Ogre::VertexDeclaration* pOptimalDecl = pDecl->getAutoOrganisedDeclaration(
 				params.exportVBA,params.exportBlendShapes || params.exportVertAnims, false); // TODO figure out what the parameter is
-			// Fill the vertex buffer using the newly created vertex declaration
-			stat = createOgreVertexBuffer(pSubmesh,pDecl,m_vertices);
-			// Write vertex bone assignements list
-			if (params.exportVBA)
+			Ogre::HardwareBufferManager::getSingleton().destroyVertexDeclaration(pDecl);
+			pSubmesh->vertexData->vertexDeclaration = pOptimalDecl;
+			// Create a vertex buffer for each source of the declaration
+			for (unsigned short source=0; source<=pOptimalDecl->getMaxSource(); source++)
 			{
-				// Create a new vertex bone assignements list
-				Ogre::SubMesh::VertexBoneAssignmentList vbas;
-				// Scan list of shared geometry vertices
-				for (int i=0; i<m_vertices.size(); i++)
-				{
-					vertex v = m_vertices[i];
-					// Add all bone assignemnts for every vertex to the bone assignements list
-					for (int j=0; j<v.vbas.size(); j++)
-					{
-						Ogre::VertexBoneAssignment vba;
-						vba.vertexIndex = i;
-						vba.boneIndex = v.vbas[j].jointIdx;
-						vba.weight = v.vbas[j].weight;
-						vbas.insert(Ogre::SubMesh::VertexBoneAssignmentList::value_type(i, vba));
-					}
-				}
-				// Rationalise the bone assignements list
-				pSubmesh->parent->_rationaliseBoneAssignments(pSubmesh->vertexData->vertexCount,vbas);
-				// Add bone assignements to the submesh
-				for (Ogre::SubMesh::VertexBoneAssignmentList::iterator bi = vbas.begin(); bi != vbas.end(); bi++)
-				{
-					pSubmesh->addBoneAssignment(bi->second);
-				}
-				pSubmesh->_compileBoneAssignments();
+				Ogre::HardwareVertexBufferSharedPtr vbuf = 
+					Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(pOptimalDecl->getVertexSize(source),
+					pSubmesh->vertexData->vertexCount, 
+					Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+				pSubmesh->vertexData->vertexBufferBinding->setBinding(source, vbuf);
 			}
-			pSubmesh->vertexData->reorganiseBuffers(pOptimalDecl);
 		}
 		return MS::kSuccess;
 	}
 
+	// Fill the Ogre submesh buffers and collect bone assignments
+	MStatus Submesh::fillOgreSubmesh(const ParamList& params)
+	{
+		MStatus stat;
+		Ogre::SubMesh* pSubmesh = m_pOgreSubmesh;
+		if (!pSubmesh)
+			return MS::kFailure;
+		// Fill the index buffer with faces data
+		Ogre::HardwareIndexBufferSharedPtr ibuf = pSubmesh->indexData->indexBuffer;
+		if (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT)
+        {
+			Ogre::uint32* pIdx = static_cast<Ogre::uint32*>(ibuf->lock(Ogre::HardwareBuffer::HBL_DISCARD));
+			for (int i=0; i<m_faces.size(); i++)
+			{
+				*pIdx++ = static_cast<Ogre::uint32>(m_faces[i].v[0]);
+				*pIdx++ = static_cast<Ogre::uint32>(m_faces[i].v[1]);
+				*pIdx++ = static_cast<Ogre::uint32>(m_faces[i].v[2]);
+			}
+			ibuf->unlock();
+        }
+        else
+        {
+            Ogre::uint16* pIdx = static_cast<Ogre::uint16*>(ibuf->lock(Ogre::HardwareBuffer::HBL_DISCARD));
+            for (int i=0; i<m_faces.size(); i++)
+			{
+				*pIdx++ = static_cast<Ogre::uint16>(m_faces[i].v[0]);
+				*pIdx++ = static_cast<Ogre::uint16>(m_faces[i].v[1]);
+				*pIdx++ = static_cast<Ogre::uint16>(m_faces[i].v[2]);
+			}
+			ibuf->unlock();
+		}
+		// Shared geometry vertices are written by the mesh
+		if (params.useSharedGeom)
+			return MS::kSuccess;
+		// Fill the vertex buffers
+		stat = fillOgreVertexBuffers(pSubmesh->vertexData,m_vertices);
+		// Collect vertex bone assignements, already rationalised
+		m_ogreBoneAssignments.clear();
+		if (params.exportVBA)
+		{
+			m_ogreBoneAssignments.reserve(m_vertices.size() * OGRE_MAX_BLEND_WEIGHTS);
+			for (int i=0; i<m_vertices.size(); i++)
+				rationaliseBoneAssignments(m_vertices[i],i,m_ogreBoneAssignments);
+		}
+		return stat;
+	}
+
+	// Add collected bone assignments to the Ogre submesh
+	MStatus Submesh::addOgreBoneAssignments(const ParamList& params)
+	{
+		Ogre::SubMesh* pSubmesh = m_pOgreSubmesh;
+		if (!pSubmesh || params.useSharedGeom || !params.exportVBA)
+			return MS::kSuccess;
+		// Add bone assignements to the submesh. Blend index and weight buffers can't be built here:
+		// the .mesh format only stores the assignment list, from which Ogre rebuilds the buffers
+		// and the blend index to bone index map when the mesh is loaded
+		for (int i=0; i<m_ogreBoneAssignments.size(); i++)
+		{
+			pSubmesh->addBoneAssignment(m_ogreBoneAssignments[i]);
+		}
+		m_ogreBoneAssignments.clear();
+		return MS::kSuccess;
+	}
 
-	// Create an Ogre compatible vertex buffer
-	MStatus Submesh::createOgreVertexBuffer(Ogre::SubMesh* pSubmesh,Ogre::VertexDeclaration* pDecl,const std::vector<vertex>& vertices)
+	// Append the strongest influences of a vertex to a bone assignments list, with their weights
+	// normalised. This does in a single pass over the vertex what Ogre's rationalisation of the
+	// whole assignments multimap does
+	void Submesh::rationaliseBoneAssignments(const vertex& v,unsigned int vertexIndex,std::vector<Ogre::VertexBoneAssignment>& vbas)
 	{
-		Ogre::HardwareVertexBufferSharedPtr vbuf = 
-			Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(pDecl->getVertexSize(0),
-			pSubmesh->vertexData->vertexCount, 
-			Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-		pSubmesh->vertexData->vertexBufferBinding->setBinding(0, vbuf);
-		size_t vertexSize = pDecl->getVertexSize(0);
-		char* pBase = static_cast<char*>(vbuf->lock(Ogre::HardwareBuffer::HBL_DISCARD));
-		Ogre::VertexDeclaration::VertexElementList elems = pDecl->findElementsBySource(0);
-		Ogre::VertexDeclaration::VertexElementList::iterator ei, eiend;
+		// keep the influences sorted by decreasing weight, vertices only have a handful of them
+		Ogre::VertexBoneAssignment best[OGRE_MAX_BLEND_WEIGHTS];
+		int numBest = 0;
+		for (int i=0; i<v.vbas.size(); i++)
+		{
+			float weight = v.vbas[i].weight;
+			if (weight <= 0)
+				continue;
+			int pos = numBest;
+			while (pos > 0 && best[pos-1].weight < weight)
+				pos--;
+			if (pos >= OGRE_MAX_BLEND_WEIGHTS)
+				continue;
+			if (numBest < OGRE_MAX_BLEND_WEIGHTS)
+				numBest++;
+			for (int j=numBest-1; j>pos; j--)
+				best[j] = best[j-1];
+			best[pos].vertexIndex = vertexIndex;
+			best[pos].boneIndex = v.vbas[i].jointIdx;
+			best[pos].weight = weight;
+		}
+		// normalise the weights of the kept influences
+		float totalWeight = 0;
+		for (int i=0; i<numBest; i++)
+			totalWeight += best[i].weight;
+		for (int i=0; i<numBest; i++)
+		{
+			best[i].weight /= totalWeight;
+			vbas.push_back(best[i]);
+		}
+	}
+
+
+	// Fill all vertex buffers bound to an Ogre vertex data
+	MStatus Submesh::fillOgreVertexBuffers(Ogre::VertexData* pVertexData,const std::vector<vertex>& vertices)
+	{
+		Ogre::VertexDeclaration* pDecl = pVertexData->vertexDeclaration;
+		const Ogre::VertexDeclaration::VertexElementList& elems = pDecl->getElements();
+		Ogre::VertexDeclaration::VertexElementList::const_iterator ei, eiend;
 		eiend = elems.end();
+		// Lock all buffers
+		std::vector<Ogre::HardwareVertexBufferSharedPtr> vbufs;
+		std::vector<char*> pBases;
+		std::vector<size_t> vertexSizes;
+		for (unsigned short source=0; source<=pDecl->getMaxSource(); source++)
+		{
+			Ogre::HardwareVertexBufferSharedPtr vbuf = pVertexData->vertexBufferBinding->getBuffer(source);
+			vbufs.push_back(vbuf);
+			vertexSizes.push_back(vbuf->getVertexSize());
+			pBases.push_back(static_cast<char*>(vbuf->lock(Ogre::HardwareBuffer::HBL_DISCARD)));
+		}
 		float* pFloat;
 		Ogre::RGBA* pRGBA;
-		// Fill the vertex buffer with shared geometry data
-		Ogre::ColourValue col;
-		float ucoord, vcoord;
+		Ogre::VertexElementType colourType = Ogre::VertexElement::getBestColourVertexElementType();
+		// Fill the vertex buffers with vertex data
 		for (long vi=0; vi<vertices.size(); vi++)
 		{
-			int iTexCoord = 0;
-			vertex v = vertices[vi];
+			const vertex& v = vertices[vi];
 			for (ei = elems.begin(); ei != eiend; ++ei)
 			{
-				Ogre::VertexElement& elem = *ei;
+				const Ogre::VertexElement& elem = *ei;
+				char* pBase = pBases[elem.getSource()] + vi * vertexSizes[elem.getSource()];
 				switch(elem.getSemantic())
 				{
 				case Ogre::VES_POSITION:
@@ -547,23 +638,20 @@ namespace OgreMayaExporter
 					{
 						elem.baseVertexPointerToElement(pBase, &pRGBA);
 						Ogre::ColourValue col(v.r, v.g, v.b, v.a);
-						*pRGBA = Ogre::VertexElement::convertColourValue(col, 
-							Ogre::VertexElement::getBestColourVertexElementType());
+						*pRGBA = Ogre::VertexElement::convertColourValue(col, colourType);
 					}
 					break;
 				case Ogre::VES_TEXTURE_COORDINATES:
 					elem.baseVertexPointerToElement(pBase, &pFloat);
-					ucoord = v.texcoords[iTexCoord].u;
-					vcoord = v.texcoords[iTexCoord].v;
-					*pFloat++ = ucoord;
-					*pFloat++ = vcoord;
-					iTexCoord++;
+					*pFloat++ = v.texcoords[elem.getIndex()].u;
+					*pFloat++ = v.texcoords[elem.getIndex()].v;
 					break;
 				}
 			}
-			pBase += vertexSize;
 		}
-		vbuf->unlock();
+		// Unlock all buffers
+		for (int i=0; i<vbufs.size(); i++)
+			vbufs[i]->unlock();
 		return MS::kSuccess;
 	}
 
@@ -0,0 +1,282 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "timelineSampler.cpp"
+//! \brief Single pass sampler of the animation clips for Ogre Exporter.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+
+#include "timelineSampler.h"
+#include <algorithm>
+#include <maya/MFnAnimCurve.h>
+
+namespace OgreMayaExporter
+{
+	// order requests by scene time, keeping the keys of every clip in order
+	static bool sampleRequestLess(const sampleRequest& a,const sampleRequest& b)
+	{
+		return a.time < b.time;
+	}
+
+	/***** Class TimelineSampler *****/
+	// constructor
+	TimelineSampler::TimelineSampler()
+	{
+		clear();
+	}
+
+	// destructor
+	TimelineSampler::~TimelineSampler()
+	{
+		clear();
+	}
+
+	// clear requested samples
+	void TimelineSampler::clear()
+	{
+		m_requests.clear();
+	}
+
+	// check if any of the clips is sampled at the keys of its curves
+	bool TimelineSampler::hasAutoRate(const std::vector<clipInfo>& clips)
+	{
+		for (int i=0; i<clips.size(); i++)
+		{
+			if (clips[i].rate < 0)
+				return true;
+		}
+		return false;
+	}
+
+	// find the time based anim curves upstream of a node
+	void TimelineSampler::findAnimCurves(const MObject& node,MObjectArray& curves,bool drivenKeys)
+	{
+		MStatus stat;
+		MObject root = node;
+		MItDependencyGraph it(root,MFn::kAnimCurve,MItDependencyGraph::kUpstream,
+			MItDependencyGraph::kDepthFirst,MItDependencyGraph::kNodeLevel,&stat);
+		if (MS::kSuccess != stat)
+			return;
+		for (; !it.isDone(); it.next())
+		{
+			MObject curve = it.thisNode();
+			// driven keys are sampled at the keys of their drivers
+			if (!drivenKeys && !MFnAnimCurve(curve).isTimeInput())
+				continue;
+			bool found = false;
+			for (unsigned int i=0; i<curves.length() && !found; i++)
+			{
+				if (curves[i] == curve)
+					found = true;
+			}
+			if (!found)
+				curves.append(curve);
+		}
+	}
+
+	// add samples between t0 and t1 where a curve is not linear
+	static void subdivideCurve(MFnAnimCurve& curveFn,double t0,double v0,double t1,double v1,
+		double minStep,float tolerance,std::vector<double>& times)
+	{
+		if (t1 - t0 < 2*minStep)
+			return;
+		// check the quarter points too, an ease in/out segment is linear at its middle
+		double error = 0;
+		for (int i=1; i<4; i++)
+		{
+			double t = t0 + (t1 - t0) * i / 4;
+			double v = curveFn.evaluate(MTime(t,MTime::kSeconds));
+			error = std::max(error,fabs(v - (v0 + (v1 - v0) * i / 4)));
+		}
+		if (error <= tolerance)
+			return;
+		double tm = (t0 + t1) / 2;
+		double vm = curveFn.evaluate(MTime(tm,MTime::kSeconds));
+		times.push_back(tm);
+		subdivideCurve(curveFn,t0,v0,tm,vm,minStep,tolerance,times);
+		subdivideCurve(curveFn,tm,vm,t1,v1,minStep,tolerance,times);
+	}
+
+	// get the sample times of a clip
+	MStatus TimelineSampler::getClipTimes(float start,float stop,float rate,const MObjectArray& curves,float tolerance,
+		std::vector<float>& times)
+	{
+		times.clear();
+		if (rate == 0)
+		{
+			std::cout << "invalid sample rate for the clip (must be >0, or -1 for auto), we skip it\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		if (stop < start)
+		{
+			std::cout << "invalid time range for the clip, we skip it\n";
+			std::cout.flush();
+			return MS::kFailure;
+		}
+		if (rate > 0)
+		{
+			for (float t=start; t<stop; t+=rate)
+				times.push_back(t);
+			times.push_back(stop);
+			return MS::kSuccess;
+		}
+		// auto rate: sample at the keys of the curves inside the clip range, and where
+		// the curves are not linear between keys. Samples are not closer than a frame
+		double minStep = MTime(1,MTime::uiUnit()).as(MTime::kSeconds);
+		std::vector<double> sampleTimes;
+		sampleTimes.push_back(start);
+		sampleTimes.push_back(stop);
+		for (unsigned int i=0; i<curves.length(); i++)
+		{
+			MFnAnimCurve curveFn(curves[i]);
+			std::vector<double> keyTimes;
+			keyTimes.push_back(start);
+			for (unsigned int k=0; k<curveFn.numKeys(); k++)
+			{
+				double t = curveFn.time(k).as(MTime::kSeconds);
+				if (t > start && t < stop)
+					keyTimes.push_back(t);
+			}
+			keyTimes.push_back(stop);
+			for (int k=0; k<keyTimes.size(); k++)
+				sampleTimes.push_back(keyTimes[k]);
+			for (int k=1; k<keyTimes.size(); k++)
+			{
+				double v0 = curveFn.evaluate(MTime(keyTimes[k-1],MTime::kSeconds));
+				double v1 = curveFn.evaluate(MTime(keyTimes[k],MTime::kSeconds));
+				subdivideCurve(curveFn,keyTimes[k-1],v0,keyTimes[k],v1,minStep,tolerance,sampleTimes);
+			}
+		}
+		// merge the times of all curves, at least a frame apart. The end of the clip
+		// replaces the last sample if it is closer than that
+		std::sort(sampleTimes.begin(),sampleTimes.end());
+		for (int i=0; i<sampleTimes.size(); i++)
+		{
+			if (times.empty() || sampleTimes[i] - times[times.size()-1] > minStep - 1e-5)
+				times.push_back(sampleTimes[i]);
+		}
+		if (times[times.size()-1] < stop - 1e-5)
+		{
+			if (times.size() > 1)
+				times[times.size()-1] = stop;
+			else
+				times.push_back(stop);
+		}
+		std::cout << "auto rate: " << times.size() << " samples from " << curves.length() << " animation curves\n";
+		std::cout.flush();
+		return MS::kSuccess;
+	}
+
+	// request the samples of a clip
+	void TimelineSampler::addClip(SampleConsumer* pConsumer,sampleChannel channel,int clip,const std::vector<float>& times)
+	{
+		for (int i=0; i<times.size(); i++)
+		{
+			sampleRequest r;
+			r.time = times[i];
+			r.clipTime = times[i] - times[0];
+			r.pConsumer = pConsumer;
+			r.channel = channel;
+			r.clip = clip;
+			r.key = i;
+			m_requests.push_back(r);
+		}
+	}
+
+	// evaluate the scene at all requested times
+	MStatus TimelineSampler::run(ParamList& params)
+	{
+		if (m_requests.size() <= 0)
+			return MS::kSuccess;
+		// save current time for later restore
+		MTime curTime = MAnimControl::currentTime();
+		std::stable_sort(m_requests.begin(),m_requests.end(),sampleRequestLess);
+		// list the consumers to notify before and after sampling
+		std::vector<SampleConsumer*> consumers;
+		for (int i=0; i<m_requests.size(); i++)
+		{
+			if (std::find(consumers.begin(),consumers.end(),m_requests[i].pConsumer) == consumers.end())
+				consumers.push_back(m_requests[i].pConsumer);
+		}
+		for (int i=0; i<consumers.size(); i++)
+			consumers[i]->beginSampling(params);
+		// times closer than this are evaluated only once
+		const float epsilon = 0.00001f;
+		int numFrames = 0;
+		float lastTime = 0;
+		for (int i=0; i<m_requests.size(); i++)
+		{
+			sampleRequest& r = m_requests[i];
+			if (numFrames == 0 || r.time - lastTime > epsilon)
+			{
+				MAnimControl::setCurrentTime(MTime(r.time,MTime::kSeconds));
+				lastTime = r.time;
+				numFrames++;
+			}
+			MStatus stat = r.pConsumer->sample(r.channel,r.clip,r.key,r.clipTime,params);
+			if (MS::kSuccess != stat)
+			{
+				std::cout << "Error reading animation keyframe at time: " << r.time << "\n";
+				std::cout.flush();
+			}
+		}
+		MStatus status = MS::kSuccess;
+		for (int i=0; i<consumers.size(); i++)
+		{
+			if (MS::kSuccess != consumers[i]->endSampling(params))
+				status = MS::kFailure;
+		}
+		std::cout << "Sampled " << m_requests.size() << " keys evaluating " << numFrames << " frames\n";
+		std::cout.flush();
+		//restore current time
+		MAnimControl::setCurrentTime(curTime);
+		return status;
+	}
+
+}; //end of namespace
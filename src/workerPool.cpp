@@ -0,0 +1,244 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "workerPool.cpp"
+//! \brief Worker thread pool for Ogre Exporter.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+
+#include "workerPool.h"
+
+namespace OgreMayaExporter
+{
+	/***** Class WorkerPool *****/
+	// constructor
+	WorkerPool::WorkerPool(unsigned int numThreads)
+	{
+		m_pendingJobs = 0;
+		m_stop = false;
+		if (numThreads == 0)
+			numThreads = std::thread::hardware_concurrency();
+		// a single worker runs jobs on the calling thread
+		if (numThreads > 1)
+		{
+			for (unsigned int i=0; i<numThreads; i++)
+				m_threads.push_back(std::thread(&WorkerPool::workerLoop,this));
+		}
+	}
+
+	// destructor
+	WorkerPool::~WorkerPool()
+	{
+		waitIdle();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_jobQueued.notify_all();
+		for (int i=0; i<m_threads.size(); i++)
+			m_threads[i].join();
+	}
+
+	// queue a job
+	void WorkerPool::submit(const std::function<void()>& job)
+	{
+		if (m_threads.empty())
+		{
+			runJob(job);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(job);
+			m_pendingJobs++;
+		}
+		m_jobQueued.notify_one();
+	}
+
+	// wait until all queued jobs have completed
+	void WorkerPool::wait()
+	{
+		waitIdle();
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			error = m_error;
+			m_error = nullptr;
+		}
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	// wait until all queued jobs have completed, without rethrowing
+	void WorkerPool::waitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_pendingJobs > 0)
+			m_jobsDone.wait(lock);
+	}
+
+	// run job(i) for every i in [0,count) and wait for completion
+	void WorkerPool::parallelFor(size_t count,const std::function<void(size_t)>& job)
+	{
+		for (size_t i=0; i<count; i++)
+			submit(std::bind(job,i));
+		wait();
+	}
+
+	// get number of worker threads
+	unsigned int WorkerPool::numThreads() const
+	{
+		return m_threads.empty() ? 1 : m_threads.size();
+	}
+
+	// worker thread main loop
+	void WorkerPool::workerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (!m_stop && m_jobs.empty())
+					m_jobQueued.wait(lock);
+				if (m_jobs.empty())
+					return;
+				job = m_jobs.front();
+				m_jobs.pop_front();
+			}
+			runJob(job);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_pendingJobs--;
+				if (m_pendingJobs == 0)
+					m_jobsDone.notify_all();
+			}
+		}
+	}
+
+	// run a job, an exception must not leave a worker thread or it terminates the process
+	void WorkerPool::runJob(const std::function<void()>& job)
+	{
+		try
+		{
+			job();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_error)
+				m_error = std::current_exception();
+		}
+	}
+
+	/***** Class FramePipeline *****/
+	// constructor, two slots per worker keep every worker busy while the next frame is captured
+	FramePipeline::FramePipeline(unsigned int numThreads)
+		: m_workers(numThreads), m_busy(2*m_workers.numThreads())
+	{
+		m_nextSlot = 0;
+		for (int i=0; i<m_busy.size(); i++)
+			m_busy[i].store(false);
+	}
+
+	// destructor
+	FramePipeline::~FramePipeline()
+	{
+		try
+		{
+			wait();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	// get number of frame slots
+	unsigned int FramePipeline::numSlots() const
+	{
+		return m_busy.size();
+	}
+
+	// claim the next free slot
+	unsigned int FramePipeline::acquireSlot()
+	{
+		unsigned int slot = m_nextSlot;
+		m_nextSlot = (m_nextSlot + 1) % m_busy.size();
+		while (m_busy[slot].load(std::memory_order_acquire))
+			std::this_thread::yield();
+		m_busy[slot].store(true,std::memory_order_relaxed);
+		return slot;
+	}
+
+	// process a captured slot on a worker
+	void FramePipeline::submit(unsigned int slot,const std::function<void()>& job)
+	{
+		std::atomic<bool>* pBusy = &m_busy[slot];
+		m_workers.submit([job,pBusy]()
+		{
+			// release the slot even if the job throws, or acquireSlot would wait forever
+			try
+			{
+				job();
+			}
+			catch (...)
+			{
+				pBusy->store(false,std::memory_order_release);
+				throw;
+			}
+			pBusy->store(false,std::memory_order_release);
+		});
+	}
+
+	// wait until all submitted frames have been processed
+	void FramePipeline::wait()
+	{
+		m_workers.wait();
+	}
+
+}; //end of namespace
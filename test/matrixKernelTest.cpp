@@ -0,0 +1,232 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "matrixKernelTest.cpp"
+//! \brief Test of the matrix decomposition kernel on random transformations.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+//! Builds without Maya or Ogre, for example:
+//!   g++ -O2 -I include test/matrixKernelTest.cpp src/matrixKernel.cpp -o matrixKernelTest
+//! or enable the BUILD_TESTS CMake option, which also compares the results with
+//! MTransformationMatrix (MATRIXKERNEL_TEST_MAYA).
+//!
+
+#include "matrixKernel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#ifdef MATRIXKERNEL_TEST_MAYA
+	#include <maya/MMatrix.h>
+	#include <maya/MVector.h>
+	#include <maya/MTransformationMatrix.h>
+#endif
+
+using namespace OgreMayaExporter;
+
+const double TOLERANCE = 1e-9;
+
+// random number in [-1,1]
+static double random11()
+{
+	return rand() / (double)RAND_MAX * 2 - 1;
+}
+
+// compose S * Sh * R * T in MMatrix layout, the shear matrix is lower triangular
+static void composeMatrix(double m[4][4],const double q[4],const double s[3],const double sh[3],const double t[3])
+{
+	double x=q[0], y=q[1], z=q[2], w=q[3];
+	// rotation rows for row vectors
+	double r[3][3] = {
+		{1-2*(y*y+z*z),	2*(x*y+z*w),	2*(x*z-y*w)},
+		{2*(x*y-z*w),	1-2*(x*x+z*z),	2*(y*z+x*w)},
+		{2*(x*z+y*w),	2*(y*z-x*w),	1-2*(x*x+y*y)}};
+	double shear[3][3] = {{1,0,0},{sh[0],1,0},{sh[1],sh[2],1}};
+	for (int i=0; i<3; i++)
+	{
+		for (int j=0; j<3; j++)
+		{
+			double v = 0;
+			for (int k=0; k<3; k++)
+				v += shear[i][k] * r[k][j];
+			m[i][j] = s[i] * v;
+		}
+		m[i][3] = 0;
+		m[3][i] = t[i];
+	}
+	m[3][3] = 1;
+}
+
+// report a component that differs from its expected value
+static int check(const char* what,size_t index,double value,double expected)
+{
+	if (fabs(value - expected) <= TOLERANCE * (1 + fabs(expected)))
+		return 0;
+	printf("FAILED matrix %d: %s is %.12g, expected %.12g\n",(int)index,what,value,expected);
+	return 1;
+}
+
+int main()
+{
+	// random rotations, scales, shears and translations, every third matrix is a reflection
+	// and a few have a zero scale on some axes
+	const size_t numMatrices = 3000;
+	std::vector<double> matrices(numMatrices*16);
+	double (*m)[4][4] = (double (*)[4][4])&matrices[0];
+	std::vector<double> components(numMatrices*13);
+	srand(1234);
+	for (size_t i=0; i<numMatrices; i++)
+	{
+		double q[4] = {random11(),random11(),random11(),random11()};
+		double len = sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+		double sign = q[3] < 0 ? -1 : 1;
+		for (int k=0; k<4; k++)
+			q[k] *= sign / len;
+		double s[3] = {0.01 + fabs(random11()) * 10, 0.01 + fabs(random11()) * 10, 0.01 + fabs(random11()) * 10};
+		if (i % 3 == 1)
+			s[rand() % 3] *= -1;
+		if (i % 500 == 7)
+			s[rand() % 3] = 0;
+		if (i % 500 == 8)
+		{
+			int k = rand() % 3;
+			s[k] = s[(k+1)%3] = 0;
+		}
+		if (i % 500 == 9)
+			s[0] = s[1] = s[2] = 0;
+		double sh[3] = {0,0,0};
+		if (i % 2 == 0)
+		{
+			sh[0] = random11(); sh[1] = random11(); sh[2] = random11();
+		}
+		double t[3] = {random11() * 100, random11() * 100, random11() * 100};
+		composeMatrix(m[i],q,s,sh,t);
+		double c[13] = {q[0],q[1],q[2],q[3],s[0],s[1],s[2],sh[0],sh[1],sh[2],t[0],t[1],t[2]};
+		for (int k=0; k<13; k++)
+			components[i*13+k] = c[k];
+	}
+
+	decomposedMatrices d;
+	decomposeMatrices(m,numMatrices,d);
+	int failed = 0;
+	for (size_t i=0; i<numMatrices; i++)
+	{
+		const double* c = &components[i*13];
+		bool reflection = c[4]*c[5]*c[6] < 0;
+		bool singular = c[4]*c[5]*c[6] == 0;
+		// every matrix must be rebuilt from its decomposition
+		double q[4] = {d.qx[i],d.qy[i],d.qz[i],d.qw[i]};
+		double s[3] = {d.sx[i],d.sy[i],d.sz[i]};
+		double sh[3] = {d.shxy[i],d.shxz[i],d.shyz[i]};
+		double t[3] = {d.tx[i],d.ty[i],d.tz[i]};
+		double rebuilt[4][4];
+		composeMatrix(rebuilt,q,s,sh,t);
+		for (int r=0; r<4; r++)
+		{
+			for (int k=0; k<4; k++)
+				failed += check("rebuilt element",i,rebuilt[r][k],m[i][r][k]);
+		}
+		failed += check("quaternion length",i,sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]),1);
+		if (q[3] < 0)
+		{
+			printf("FAILED matrix %d: negative qw\n",(int)i);
+			failed++;
+		}
+		// the decomposition of a reflection or a singular matrix isn't unique, the signs of the
+		// scale, shear and rotation are only checked through the rebuilt matrix
+		if (!reflection && !singular)
+		{
+			const char* names[10] = {"qx","qy","qz","qw","sx","sy","sz","shxy","shxz","shyz"};
+			double values[10] = {q[0],q[1],q[2],q[3],s[0],s[1],s[2],sh[0],sh[1],sh[2]};
+			for (int k=0; k<10; k++)
+				failed += check(names[k],i,values[k],c[k]);
+		}
+		else if (reflection)
+		{
+			const char* names[6] = {"|sx|","|sy|","|sz|","|shxy|","|shxz|","|shyz|"};
+			double values[6] = {s[0],s[1],s[2],sh[0],sh[1],sh[2]};
+			for (int k=0; k<6; k++)
+				failed += check(names[k],i,fabs(values[k]),fabs(c[4+k]));
+		}
+		for (int k=0; k<3; k++)
+			failed += check("translation",i,t[k],c[10+k]);
+#ifdef MATRIXKERNEL_TEST_MAYA
+		// compare with the decomposition of Maya, used before the kernel
+		MTransformationMatrix tm = MTransformationMatrix(MMatrix(m[i]));
+		double mq[4], ms[3], msh[3];
+		tm.getRotationQuaternion(mq[0],mq[1],mq[2],mq[3]);
+		if (mq[3] < 0)
+		{
+			for (int k=0; k<4; k++)
+				mq[k] = -mq[k];
+		}
+		tm.getScale(ms,MSpace::kPostTransform);
+		tm.getShear(msh,MSpace::kPostTransform);
+		MVector mt = tm.translation(MSpace::kPostTransform);
+		if (!singular)
+		{
+			for (int k=0; k<3; k++)
+			{
+				failed += check("|scale| against Maya",i,fabs(s[k]),fabs(ms[k]));
+				failed += check("|shear| against Maya",i,fabs(sh[k]),fabs(msh[k]));
+			}
+		}
+		if (!reflection && !singular)
+		{
+			for (int k=0; k<4; k++)
+				failed += check("quaternion against Maya",i,q[k],mq[k]);
+			for (int k=0; k<3; k++)
+				failed += check("shear against Maya",i,sh[k],msh[k]);
+		}
+		failed += check("tx against Maya",i,t[0],mt.x);
+		failed += check("ty against Maya",i,t[1],mt.y);
+		failed += check("tz against Maya",i,t[2],mt.z);
+#endif
+	}
+	printf("%d matrices, %d failure(s)\n",(int)numMatrices,failed);
+	return failed > 0 ? 1 : 0;
+}
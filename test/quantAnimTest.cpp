@@ -0,0 +1,288 @@
+/*
+---------------------------------------------------------------------------------------------
+-							       MAYA OGRE EXPORTER                                       -
+---------------------------------------------------------------------------------------------
+- Description: 	This is a plugin for Maya, that allows the export of animated               -
+-              	meshes in the OGRE file format. All meshes will be combined                 -
+-              	together to form a single OGRE mesh, each Maya mesh will be                 -
+-              	translated as a submesh. Multiple materials per mesh are allowed            -
+-              	each group of triangles sharing the same material will become               -
+-              	a separate submesh. Skeletal animation and blendshapes are                  -
+-              	supported, or, alternatively, vertex animation as a sequence                -
+-              	of morph targets.                                                           -
+-              	The export command can be run via script too, for instructions              -
+-              	on its usage please refer to the Instructions.txt file.  					-
+- Note: 		The particles exporter is an extra module submitted by the OGRE         	-
+- 				community, it still has to be reviewed and fixed.  		            		-		
+---------------------------------------------------------------------------------------------
+- Original version by Francesco Giordana, sponsored by Anygma N.V. (http://www.nazooka.com) -
+- The previous version was maintained by Filmakademie Baden-Wuerttemberg, 					-
+- Institute of Animation's R&D Lab (http://research.animationsinstitut.de)  				-
+-																							-
+- The current version (at https://www.github.com/bitgate/maya-ogre3d-exporter) is			-
+- maintained by Bitgate, Inc. for the purpose of keeping Ogre compatible with the latest	-
+- technologies.																				-
+---------------------------------------------------------------------------------------------
+- Copyright (c) 2011 MFG Baden-Wrttemberg, Innovation Agency for IT and media.             -
+- Research and Development at the Institute of Animation is a cooperation between           -
+- MFG Baden-Wrttemberg, Innovation Agency for IT and media and                             -
+- Filmakademie Baden-Wrttemberg as part of the "MFG Visual Experience Lab".                -
+---------------------------------------------------------------------------------------------
+- This program is free software; you can redistribute it and/or modify it under				-
+- the terms of the GNU Lesser General Public License as published by the Free Software		-
+- Foundation; version 2.1 of the License.													-
+-																							-
+- This program is distributed in the hope that it will be useful, but WITHOUT				-
+- ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS				-
+- FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.		-
+- 																							-
+- You should have received a copy of the GNU Lesser General Public License along with		-
+- this program; if not, write to the Free Software Foundation, Inc., 59 Temple				-
+- Place - Suite 330, Boston, MA 02111-1307, USA, or go to									-
+- http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html									-
+---------------------------------------------------------------------------------------------
+*/
+
+//!
+//! \file "quantAnimTest.cpp"
+//! \brief Test of the quantised animation decoder.
+//!
+//! \version    1.0
+//! \date       18.10.2026 (last updated)
+//!
+//! Builds without Maya or Ogre, for example:
+//!   g++ -O2 -I include test/quantAnimTest.cpp -o quantAnimTest
+//! or enable the BUILD_TESTS CMake option.
+//!
+
+#include "quantAnim.h"
+#include "binaryData.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace OgreMayaExporter;
+
+// random number in [-1,1]
+static float random11()
+{
+	return rand() / (float)RAND_MAX * 2 - 1;
+}
+
+// append a translation or scale channel with random keys
+static void putRange(std::vector<unsigned char>& data,bool constant,uint32_t numKeys,float base)
+{
+	if (constant)
+	{
+		for (int i=0; i<3; i++)
+			putFloat(data,base + random11());
+		return;
+	}
+	for (int i=0; i<3; i++)
+		putFloat(data,base - 1);
+	for (int i=0; i<3; i++)
+		putFloat(data,2);
+	for (uint32_t k=0; k<3*numKeys; k++)
+		putU16(data,rand() & 0xffff);
+}
+
+// build a file with random clips and tracks, every kind of constant channel is used
+static std::vector<unsigned char> buildFile(uint32_t numBones,int numClips)
+{
+	std::vector<unsigned char> data;
+	data.push_back('Q'); data.push_back('A'); data.push_back('N'); data.push_back('M');
+	putU32(data,QUANTANIM_VERSION);
+	putU32(data,numBones);
+	putU32(data,numClips);
+	for (int c=0; c<numClips; c++)
+	{
+		std::string name = "clip" + std::to_string(c);
+		putU16(data,name.size());
+		data.insert(data.end(),name.begin(),name.end());
+		putFloat(data,0.5f + c);
+		// one track more than the bones, the extra one has an unknown handle and must be skipped
+		putU32(data,numBones + 1);
+		for (uint32_t b=0; b<=numBones; b++)
+		{
+			uint16_t flags = (b + c) % 8;
+			uint32_t numKeys = 1 + rand() % 20;
+			putU16(data,b);
+			putU16(data,flags);
+			putU32(data,numKeys);
+			for (uint32_t k=0; k<numKeys; k++)
+				putU16(data,numKeys > 1 ? k * 65535 / (numKeys - 1) : 0);
+			putRange(data,(flags & QA_CONST_TRANSLATION) != 0,numKeys,0);
+			uint32_t numRotations = (flags & QA_CONST_ROTATION) ? 1 : numKeys;
+			for (uint32_t k=0; k<numRotations; k++)
+			{
+				float q[4] = {random11(),random11(),random11(),random11()};
+				float len = sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+				for (int i=0; i<4; i++)
+					q[i] /= len;
+				uint16_t packed[3];
+				packQuaternion(q,packed);
+				for (int i=0; i<3; i++)
+					putU16(data,packed[i]);
+			}
+			putRange(data,(flags & QA_CONST_SCALE) != 0,numKeys,1);
+		}
+	}
+	return data;
+}
+
+// compare sampleClip, interpolated four tracks at a time with SSE2 when available,
+// with sampleTrack, the scalar version, at a few times of every clip
+static int testSampleClip(const QuantAnimDecoder& decoder)
+{
+	int failed = 0;
+	quantAnimPose pose;
+	for (size_t c=0; c<decoder.clips().size(); c++)
+	{
+		const quantAnimClip& clip = decoder.clips()[c];
+		for (int s=0; s<=16; s++)
+		{
+			float time = clip.length * (s - 1) / 14.0f;
+			decoder.sampleClip(c,time,pose);
+			for (size_t j=0; j<clip.tracks.size(); j++)
+			{
+				uint16_t bone = clip.tracks[j].bone;
+				if (bone >= decoder.numBones())
+					continue;
+				float t[3], q[4], sc[3];
+				QuantAnimDecoder::sampleTrack(clip.tracks[j],clip.length,time,t,q,sc);
+				float expected[10] = {t[0],t[1],t[2],q[0],q[1],q[2],q[3],sc[0],sc[1],sc[2]};
+				float values[10] = {pose.tx[bone],pose.ty[bone],pose.tz[bone],pose.qx[bone],pose.qy[bone],pose.qz[bone],pose.qw[bone],
+					pose.sx[bone],pose.sy[bone],pose.sz[bone]};
+				for (int k=0; k<10; k++)
+				{
+					if (fabs(values[k] - expected[k]) > 1e-5f)
+					{
+						printf("FAILED testSampleClip: clip %d bone %d channel %d at %g is %g, expected %g\n",
+							(int)c,(int)bone,k,time,values[k],expected[k]);
+						failed++;
+					}
+				}
+			}
+		}
+	}
+	if (failed == 0)
+		printf("passed testSampleClip\n");
+	return failed;
+}
+
+// every truncation of a valid file must be rejected
+static int testTruncated(const std::vector<unsigned char>& data)
+{
+	QuantAnimDecoder decoder;
+	for (size_t n=0; n<data.size(); n++)
+	{
+		if (decoder.load(&data[0],n))
+		{
+			printf("FAILED testTruncated: loaded %d of %d bytes\n",(int)n,(int)data.size());
+			return 1;
+		}
+	}
+	printf("passed testTruncated\n");
+	return 0;
+}
+
+// headers and counts that don't fit the data must be rejected before anything is allocated
+static int testInvalidHeaders()
+{
+	int failed = 0;
+	QuantAnimDecoder decoder;
+	std::vector<unsigned char> data;
+	// wrong magic and version
+	data.push_back('Q'); data.push_back('A'); data.push_back('N'); data.push_back('X');
+	putU32(data,QUANTANIM_VERSION); putU32(data,1); putU32(data,0);
+	if (decoder.load(&data[0],data.size()))
+	{
+		printf("FAILED testInvalidHeaders: wrong magic accepted\n");
+		failed++;
+	}
+	data[3] = 'M';
+	data[4] = QUANTANIM_VERSION + 1;
+	if (decoder.load(&data[0],data.size()))
+	{
+		printf("FAILED testInvalidHeaders: wrong version accepted\n");
+		failed++;
+	}
+	// huge number of clips
+	data.resize(4);
+	putU32(data,QUANTANIM_VERSION); putU32(data,1); putU32(data,0xffffffffu);
+	if (decoder.load(&data[0],data.size()))
+	{
+		printf("FAILED testInvalidHeaders: huge clip count accepted\n");
+		failed++;
+	}
+	// huge number of tracks
+	data.resize(12);
+	putU32(data,1); putU16(data,0); putFloat(data,1); putU32(data,0xffffffffu);
+	if (decoder.load(&data[0],data.size()))
+	{
+		printf("FAILED testInvalidHeaders: huge track count accepted\n");
+		failed++;
+	}
+	// huge number of keys, and no keys
+	data.resize(data.size() - 4);
+	putU32(data,1);
+	size_t trackStart = data.size();
+	putU16(data,0); putU16(data,0); putU32(data,0x60000000u);
+	data.resize(data.size() + 64,0);
+	if (decoder.load(&data[0],data.size()))
+	{
+		printf("FAILED testInvalidHeaders: huge key count accepted\n");
+		failed++;
+	}
+	data.resize(trackStart);
+	putU16(data,0); putU16(data,QA_CONST_TRANSLATION | QA_CONST_ROTATION | QA_CONST_SCALE); putU32(data,0);
+	data.resize(data.size() + 64,0);
+	if (decoder.load(&data[0],data.size()))
+	{
+		printf("FAILED testInvalidHeaders: track without keys accepted\n");
+		failed++;
+	}
+	if (failed == 0)
+		printf("passed testInvalidHeaders\n");
+	return failed;
+}
+
+// random corruption must either be rejected or give a file that can be sampled
+static int testCorrupted(const std::vector<unsigned char>& data)
+{
+	QuantAnimDecoder decoder;
+	quantAnimPose pose;
+	int numLoaded = 0;
+	for (int n=0; n<2000; n++)
+	{
+		std::vector<unsigned char> corrupted = data;
+		int numFlips = 1 + rand() % 4;
+		for (int i=0; i<numFlips; i++)
+			corrupted[rand() % corrupted.size()] ^= (unsigned char)(1 << (rand() % 8));
+		if (!decoder.load(&corrupted[0],corrupted.size()))
+			continue;
+		numLoaded++;
+		for (size_t c=0; c<decoder.clips().size(); c++)
+			decoder.sampleClip(c,decoder.clips()[c].length * 0.5f,pose);
+	}
+	printf("passed testCorrupted, %d of 2000 corrupted files loaded and sampled\n",numLoaded);
+	return 0;
+}
+
+int main()
+{
+	srand(1234);
+	int failed = 0;
+	std::vector<unsigned char> data = buildFile(13,3);
+	QuantAnimDecoder decoder;
+	if (!decoder.load(&data[0],data.size()))
+	{
+		printf("FAILED: valid file rejected\n");
+		return 1;
+	}
+	failed += testSampleClip(decoder);
+	failed += testTruncated(data);
+	failed += testInvalidHeaders();
+	failed += testCorrupted(data);
+	printf("%d failure(s)\n",failed);
+	return failed > 0 ? 1 : 0;
+}